@@ -0,0 +1,78 @@
+/**
+ *  VDX7 - Virtual DX7 synthesizer emulation
+ *  Copyright (C) 2023  chiaccona@gmail.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+**/
+
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <strings.h>
+
+// Runtime CPU feature dispatch
+//
+// On x86 the DSP kernels (EGS::clock and the OPS op spans) are compiled for
+// each instruction set below with GCC target attributes, whatever the build
+// flags, and the best one the CPU supports is chosen at startup. So a
+// generic (SSE2) build still runs the AVX2 or AVX-512 code where it can.
+// Elsewhere there is only the one, built for the target (e.g. USE_ARM).
+// The variants are bit exact. So the float code (the EGS output filter) is
+// never built for AVX-512, which implies FMA in GCC and would round the
+// filter differently: that level only has OPS kernels.
+//
+// VDX7_ISA=sse2|avx2|avx512 in the environment caps the choice, e.g. to
+// compare them with opsbench.
+
+enum class Isa { Base, AVX2, AVX512 };
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MULTI_ISA
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx2,avx512f,avx512bw,avx512dq,avx512vl")))
+static constexpr int Isas = 3;
+static constexpr const char *isaNames[Isas] = { "sse2", "avx2", "avx512" };
+#else
+static constexpr int Isas = 1;
+static constexpr const char *isaNames[Isas] = { "generic" };
+#endif
+
+inline const char *isaName(Isa isa) { return isaNames[int(isa)]; }
+
+// The kernels to use, chosen on the first call
+inline Isa cpuIsa() {
+	static const Isa isa = [] {
+		int best = 0;
+#ifdef MULTI_ISA
+		__builtin_cpu_init();
+		if(__builtin_cpu_supports("avx2")) {
+			best = int(Isa::AVX2);
+			if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+				&& __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl"))
+				best = int(Isa::AVX512);
+		}
+#endif
+		if(const char *cap = getenv("VDX7_ISA")) {
+			int i = 0;
+			while(i < Isas && strcasecmp(cap, isaNames[i])) i++;
+			if(i == Isas) fprintf(stderr, "VDX7_ISA=%s unknown, ignored\n", cap);
+			else if(i > best) fprintf(stderr, "VDX7_ISA=%s not supported by this CPU, ignored\n", cap);
+			else best = i;
+		}
+		fprintf(stderr, "DSP kernels: %s\n", isaNames[best]);
+		return Isa(best);
+	}();
+	return isa;
+}
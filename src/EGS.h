@@ -19,6 +19,7 @@
 #pragma once
 #include <cstdint>
 #include <cstdio>
+#include <array>
 
 // Force G++ to inline EGS and OPS clock functions
 #ifdef INLINE_EGS
@@ -34,86 +35,139 @@
 // Envelope is inverted - 0xFFF is "off" and 0 is maximum
 // i.e. represents an attenuation
 
-struct Envelope {
-	Envelope() { }
+// Envelopes of one operator for all 16 voices, as arrays (structure of
+// arrays) so that a whole row can be clocked at once.
+struct EnvelopeBank {
+	EnvelopeBank() { }
 
 	enum Stage { S0, S1, S2, S3 };
+	static constexpr int V = 16; // Voices
 
-	uint8_t *rates=0, *levels=0;
-    uint8_t *outparam=0;
-	bool keyoff = false;
-	uint8_t ratescaling = 0;
-
-	// These are signed to catch
-	// underflows and compares, but not strictly necessary
-	// because firmware ensures target capped at 64
-	// (outparam>=0x04), and max decrement is 32.
-	int16_t level = 0xFF0;
-	int16_t target = 0xFF0;
-
-	bool rising = false;
-	Stage stage = S3;
-	bool compress = true; // flag for compressed stage 0 delay
-
+	uint8_t *rates=0, *levels=0; // rates[4] and levels[4] of the operator
+	uint8_t *outparam=0; // outparam[16], operator level by voice
 	uint16_t *clock = 0; // One master clock for all envelopes (need to init)
-	uint8_t nshift = 0, pshift = 0; // value stored as positive or negative
-	uint16_t small = 0; // clock bitmask for slow rates
-	uint8_t mask = 0; // flags for fractional qrate output
 
-	void key_on() { keyoff = false; advance(); }
-	void key_off() { keyoff = true; advance(); }
+	// Per voice state
+	// Levels are signed to catch underflows and compares, but not strictly
+	// necessary because firmware ensures target capped at 64
+	// (outparam>=0x04), and max decrement is 32.
+	int32_t level[V], target[V];
+	int32_t stage[V];
+	int32_t rising[V], keyoff[V];
+	int32_t compress[V]; // flag for compressed stage 0 delay
+	int32_t ratescaling[V];
+	int32_t nshift[V], pshift[V]; // value stored as positive or negative
+	int32_t small[V]; // clock bitmask for slow rates
+	int32_t mask[V]; // flags for fractional qrate output
+
+	void key_on(int v) { keyoff[v] = false; advance(v); }
+	void key_off(int v) { keyoff[v] = true; advance(v); }
 
 	void init(uint8_t *r, uint8_t *l, uint8_t *op, uint16_t *clk) {
-    	rates = r; levels = l; outparam = op; clock = clk;
-		key_off();
+		rates = r; levels = l; outparam = op; clock = clk;
+		for(int v=0; v<V; v++) {
+			level[v] = target[v] = 0xFF0;
+			stage[v] = S3;
+			rising[v] = false;
+			compress[v] = true;
+			ratescaling[v] = 0;
+			nshift[v] = pshift[v] = small[v] = mask[v] = 0;
+			due[v] = Never;
+			key_off(v);
+		}
 	}
 
 	// Output is a 12 bit attenuation (i.e. inverted, 0xFFF is "zero")
-	uint16_t getsample() {
-		if (stage>1 && (level == target)) return level;  // short circuit if target reached
-		if ((!(*clock & small)) // fall thru once every 2^nshift cycles
-			&& (mask & (1<<((*clock>>nshift)&7))) // Clock out fractional qrates
-			) {
-			if (rising) { // "rising" down
-				if (level>0x94C) level = 0x94C; // jumpstart: 4096-1716=2380=0x94C
-				int slope = (level>>8) + 2; // 11 to 2 by log(level)
-				level -= slope<<pshift;
-				// NB level can't actually underflow due to
-				// firmware capping outparam at 0x04. This (signed) code should work
-				// even if outparam is not capped (the actual hardware would glitch)
-				if (level <= target) { // go to next stage
-					level = target;
-					advance();
-				}
-			} else { // "falling" up 
-				level += 1<<pshift;
-				if (level >= target) { // go to next stage
-					level = target;
-					advance();
-				}
+	// Called once per envelope clock, only when the level is due to move
+	void getsample(int v) {
+		if (rising[v]) { // "rising" down
+			if (level[v]>0x94C) level[v] = 0x94C; // jumpstart: 4096-1716=2380=0x94C
+			int slope = (level[v]>>8) + 2; // 11 to 2 by log(level)
+			level[v] -= slope<<pshift[v];
+			// NB level can't actually underflow due to
+			// firmware capping outparam at 0x04. This (signed) code should work
+			// even if outparam is not capped (the actual hardware would glitch)
+			if (level[v] <= target[v]) { // go to next stage
+				level[v] = target[v];
+				advance(v);
+			}
+		} else { // "falling" up 
+			level[v] += 1<<pshift[v];
+			if (level[v] >= target[v]) { // go to next stage
+				level[v] = target[v];
+				advance(v);
 			}
 		}
-		return level; // stage 2 sustained
 	}
 
-	void advance() {
+	// Next tick scheduling
+	// A level only moves on the clocks where (clock & small)==0 and the
+	// outmask bit for (clock>>nshift)&7 is set, so each voice keeps the
+	// clock of its next move in due (Never once sustained at its target),
+	// and the bank the soonest of them in next. Rate, level and key changes
+	// mark a voice pending, to be rescheduled on its next visit.
+	static constexpr int32_t Never = -1;
+	int32_t due[V];
+	uint16_t next = 0; // Soonest due, or a clock value not reached for a while
+	uint16_t pending = 0; // By voice
+
+	void schedule(int v, uint16_t from) {
+		if ((stage[v]>1 && level[v] == target[v]) || !mask[v]) { due[v] = Never; return; }
+		// First multiple of 2^nshift from there with its fractional qrate bit set
+		uint32_t k = (uint32_t(from) + small[v]) >> nshift[v];
+		while (!((mask[v]>>(k&7)) & 1)) k++;
+		due[v] = uint16_t(k<<nshift[v]);
+		if (uint16_t(due[v] - *clock) < uint16_t(next - *clock)) next = due[v];
+	}
+
+	// Clock voices [from, to) once, leaving the outputs in level. Each voice is
+	// visited once per envelope clock, and the whole call is skipped if none
+	// of them is due.
+	void getsamples(int from, int to) {
+		const uint16_t clk = *clock;
+		uint16_t span = ((1<<to) - 1) & ~((1<<from) - 1);
+		if (clk != next && !(pending & span)) return;
+		for (int v=from; v<to; v++) {
+			if ((pending>>v) & 1) {
+				pending &= ~(1<<v);
+				schedule(v, clk);
+			}
+			if (due[v] != clk) continue;
+			getsample(v);
+			pending &= ~(1<<v); // if advanced
+			schedule(v, clk+1);
+		}
+		// All voices have moved past this clock: find the soonest again
+		if (to == V && clk == next) {
+			uint16_t soonest = 0xFFFF;
+			for (int v=0; v<V; v++) {
+				if (due[v] == Never) continue;
+				uint16_t d = due[v] - clk;
+				if (d < soonest) soonest = d;
+			}
+			next = clk + soonest;
+		}
+	}
+
+	void advance(int v) {
 		// Stage state machine, with delay compression logic
-		switch(stage) {
+		switch(stage[v]) {
 			case S0:
-				if(keyoff) { stage = S3; compress = true; }
-				else { stage = S1; compress = false; }
+				if(keyoff[v]) { stage[v] = S3; compress[v] = true; }
+				else { stage[v] = S1; compress[v] = false; }
 				break;
-			case S1: if(keyoff) stage = S3; else stage = S2; break;
-			case S2: if(keyoff) stage = S3; else return; break;
-			case S3: if(!keyoff) stage = S0; else return; break;
+			case S1: if(keyoff[v]) stage[v] = S3; else stage[v] = S2; break;
+			case S2: if(keyoff[v]) stage[v] = S3; else return; break;
+			case S3: if(!keyoff[v]) stage[v] = S0; else return; break;
 		}
-		updateLevel();
-		updateRate();
+		updateLevel(v);
+		updateRate(v);
 	}
-	void updateLevel() {
+	void updateLevel(int v) {
+		pending |= 1<<v;
 		// max target is 0x040 (with outparam=0x04, levels[stage]=0x00)
-		target = (levels[stage]<<6) + ((*outparam)<<4);
-		if(target>0xFF0) target = 0xFF0; // Minimum level is 4096-16
+		target[v] = (levels[stage[v]]<<6) + (outparam[v]<<4);
+		if(target[v]>0xFF0) target[v] = 0xFF0; // Minimum level is 4096-16
 
 		// Set up delay when env level and prev level >= 40 (i.e. env
 		// level param <20).  Small levels are inaudible, hence
@@ -129,32 +183,33 @@ struct Envelope {
 		// (because because they only exit on key events). Behavior is
 		// used e.g. in "WATER GDN" and "CHIMES" voices.
 
-		int prev = (stage+3)&3;
-		if(stage<2 && levels[stage] >= 40 && levels[prev] >= 40) {
+		int prev = (stage[v]+3)&3;
+		if(stage[v]<2 && levels[stage[v]] >= 40 && levels[prev] >= 40) {
 			// compressed delay is round(479/32) = 15
-			int delay = (stage==0 && compress) ? 15 : 479;
-			target = level + delay;
-			if(target>0xFF0) { // clamp
-				level = 0xFF0-delay;
-				target = 0xFF0;
+			int delay = (stage[v]==0 && compress[v]) ? 15 : 479;
+			target[v] = level[v] + delay;
+			if(target[v]>0xFF0) { // clamp
+				level[v] = 0xFF0-delay;
+				target[v] = 0xFF0;
 			}
 		}
-		rising = (target < level); // attack mode: actually falling, since inverted
+		rising[v] = (target[v] < level[v]); // attack mode: actually falling, since inverted
 	}
 
-	void updateRate() {
-		uint8_t qrate = rates[stage]+ratescaling;
+	void updateRate(int v) {
+		pending |= 1<<v;
+		uint8_t qrate = rates[stage[v]]+ratescaling[v];
 		if(qrate>63) qrate = 63;
 
 		// nshift: 0-3=11, 4-7=10 ... 40-43=1, 44-63=0
 		// pshift: 0-47=0, 48-51=1, 52-55=2, 56-59=3, 60-63=4
-		pshift = nshift = small = 0;
+		pshift[v] = nshift[v] = small[v] = 0;
 		if(qrate<44) {
-			nshift = 11 - (qrate>>2); // clock shift value
-			small = (1<<nshift) - 1; // bitmask to detect shifted clock transition
-		} else pshift = (qrate>>2) - 11; // increment shift value
+			nshift[v] = 11 - (qrate>>2); // clock shift value
+			small[v] = (1<<nshift[v]) - 1; // bitmask to detect shifted clock transition
+		} else pshift[v] = (qrate>>2) - 11; // increment shift value
 		
-		mask = outmask[qrate&3]; // fractional qrate flags
+		mask[v] = outmask[qrate&3]; // fractional qrate flags
 	}
 
 	// Bit patterns indicating when to clock out samples
@@ -163,29 +218,50 @@ struct Envelope {
 	static constexpr const uint8_t outmask[4] = { 0xAA, 0xEA, 0xEE, 0xFE };
 };
 
+// Rate scaling
+// Per the (linear) graph in the user manual:
+//                  rateScaling:  7  6  5  4  3  2  1  0
+//  A(-1) (midi  21, 27.5Hz)  ->  0  0  0  0  0  0  0  0 
+//  F#(7) (midi 102, 2960Hz)  -> 42 36 30 24 18 12  6  0
+//  (in 0-99 rate units, with rate=qrate*64/41
+// This replicates the table in qrate units, by rate scaling and the note
+// in voicePitch units (voicePitch>>8). In hardware this is surely a ROM.
+// round(n*rateScaling/7) never ties, so it is exact in integers.
+constexpr std::array<std::array<uint8_t, 64>, 8> rateScalingROM() {
+	std::array<std::array<uint8_t, 64>, 8> rom{};
+	for(int rs=0; rs<8; rs++) for(int note=0; note<64; note++) {
+		int n = note<16 ? 0 : note>43 ? 27 : note-16;
+		rom[rs][note] = (2*n*rs + 7) / 14;
+	}
+	return rom;
+}
+
 class EGS {
 public:
 	EGS(uint8_t *m) :
-		mem(m),
-		opDetune(m+0x30),
-		opEGrates((uint8_t(*)[4])(m+0x40)),
-		opEGlevels((uint8_t(*)[4])(m+0x60)),
-		opLevels((uint8_t(*)[16])(m+0x80)),
-		opSensScale(m+0xE0),
-		ampMod(*(m+0xF0)),
-		voiceEvents(*(m+0xF1)),
+		mem(regs),
+		opDetune(regs+0x30),
+		opEGrates((uint8_t(*)[4])(regs+0x40)),
+		opEGlevels((uint8_t(*)[4])(regs+0x60)),
+		opLevels((uint8_t(*)[16])(regs+0x80)),
+		opSensScale(regs+0xE0),
+		ampMod(*(regs+0xF0)),
+		voiceEvents(*(regs+0xF1)),
 		ops(frequency, envelope)
 	{
-		for(int i=0; i<256; i++) mem[i] = 0xFF; // Initially all ones
-		for(int op=0; op<6; op++) {
-			for(int voice=0; voice<16; voice++) { // initialize pointers in envelopes
-				env[op][voice].init(opEGrates[op], opEGlevels[op], &(opLevels[op][voice]), &env_clock);
-			}
+		for(int i=0; i<256; i++) m[i] = mem[i] = 0xFF; // Initially all ones
+		for(int op=0; op<6; op++) { // initialize pointers in envelopes
+			env[op].init(opEGrates[op], opEGlevels[op], opLevels[op], &env_clock);
+			updateOpBase(op);
 		}
+		isa(cpuIsa());
 	}
 
 private:
-	uint8_t *mem; // Pointer to start of EGS buffers at cpu.memory[0x3000]
+	// The EGS buffers as written by the CPU at cpu.memory[0x3000]. A copy,
+	// since in run-ahead the CPU is ahead of the EGS (see write())
+	uint8_t regs[256];
+	uint8_t *mem;
 
 	// EGS registers
 	uint16_t voicePitch[16]={0};
@@ -199,11 +275,68 @@ private:
 	uint8_t &voiceEvents;
 	int16_t pitchMod=0;
 
+	// Frequency before pitch mod and clamping, and which ops pitch mod applies
+	// to (all ones for ratio ops), so that a pitch mod write is one pass.
+	// They take the op pitch and detune registers as written, but like the
+	// chip those only reach the OPS with the next voice pitch or pitch mod.
+	int32_t freqBase[6][16] = {{0}};
+	int32_t opBase[6] = {0};
+	int32_t ratio[6] = {0};
+	static constexpr std::array<std::array<uint8_t, 64>, 8> rateScaling = rateScalingROM();
+
 	// Envelopes
-	Envelope env[6][16];
+	EnvelopeBank env[6]; // By op
 	int currOp=0, currVoice=0;
 	uint16_t env_clock = 0; // Master envelope clock
 
+	// Sleeping voices
+	// A voice whose envelopes are all at rest (past the attack and decay, at
+	// their target) with an attenuation of 0xE00 or more gives an OPS output
+	// of exactly zero whatever its phase and modulation. Once its modulation
+	// state has settled to zero too, running it only advances its phases, so
+	// it is put to sleep: the OPS skips it, and its phases are caught up in
+	// one step when it wakes (key events, or writes that could change its
+	// envelopes) or before its frequency changes.
+	uint16_t sleeping = 0; // By voice
+	uint32_t samples = 0; // Output samples (wraps)
+	uint32_t synced[6][16] = {0}; // Value of ran() each phase was caught up to
+
+	// Cycles of op run for voice so far, counting the current sample
+	uint32_t ran(int op, int voice) {
+		return samples + (op < currOp || (op == currOp && voice < currVoice));
+	}
+	void catchUp(int voice) {
+		for(int op=0; op<6; op++) {
+			uint32_t now = ran(op, voice);
+			ops.skip(op, voice, now - synced[op][voice]);
+			synced[op][voice] = now;
+		}
+	}
+	void wake(int voice) {
+		if(!(sleeping>>voice & 1)) return;
+		catchUp(voice);
+		ops.resume(voice, voice < currVoice ? currOp : (currOp+5)%6);
+		sleeping &= ~(1<<voice);
+	}
+	void wakeAll() { for(int voice=0; sleeping; voice++) wake(voice); }
+
+	// Called between samples
+	void sleep() {
+		// Large amp mod sensitivities could wrap the envelope sum
+		for(int op=0; op<6; op++) if((opSensScale[op]>>3) > 7) return;
+		for(int voice=0; voice<16; voice++) {
+			if(sleeping>>voice & 1 || !ops.quiet(voice)) continue;
+			bool silent = true;
+			for(int op=0; op<6; op++) {
+				const EnvelopeBank &e = env[op];
+				silent &= e.stage[voice] > 1 && e.level[voice] == e.target[voice] && e.level[voice] >= 0xE00;
+			}
+			if(!silent) continue;
+			for(int op=0; op<6; op++) synced[op][voice] = samples;
+			sleeping |= 1<<voice;
+		}
+	}
+
 	// Outputs to OPS
 	uint16_t frequency[6][16] = {0};
 	uint16_t envelope[6][16] = {0};
@@ -214,61 +347,201 @@ private:
 	// 5th order decimation filter (Sallen-Key)
 	// Introduces a bit of aliasing noise consistent with hardware synth
 	Filter skFilter;
-	float filter(int32_t *out) {
+	template<bool clean> float filter(int32_t *out) {
 		float ret = 0;
 		// Gain trim for 15 bit full scale
 		constexpr const float cgain = 1.0/float(1<<15);
 		constexpr const float gain = 16.0/float(1<<15);
 		// Optionally no filtering or decimation
 		// Otherwise, apply S-K filter as in hardware
-		if(clean_) for(int v=0; v<16; v++) ret += cgain * out[v];
-		else for(int v=0; v<16; v++) ret = skFilter.operate(gain * out[v]);
+		if(clean) for(int v=0; v<16; v++) ret += cgain * out[v];
+		else {
+			float in[16];
+			for(int v=0; v<16; v++) in[v] = gain * out[v];
+			ret = skFilter.operate(in);
+		}
 		return ret;
 	}
 
+	// Or the 16 voices as they are, for the fused output stage to filter
+	// (see DX7Synth::fuse), at the same gain
+	void subsamples(int32_t *out, float *outbuf) {
+		constexpr const float gain = 16.0/float(1<<15);
+		for(int v=0; v<16; v++) outbuf[v] = gain * out[v];
+	}
+
 	bool clean_ = false;
+	bool subsamples_ = false;
+	Isa isa_ = Isa::Base;
+
+	void setClean(bool v) { clean_ = v; ops.clean(v); }
 
 public:
 	// Optionally allow full resolution output and no filtering,
 	// removing the "dirty" signal processing, i.e.
 	// the S-K filtering, and the level shifter circuitry
-	void clean(bool v) { clean_ = v; ops.clean(v); }//fprintf(stderr, "clean(%d)\n", v); }
+	// With run-ahead it is logged, and applies from the start of the batch.
+	void clean(bool v) {
+		if(runAhead_) batch->clean = v;
+		else setClean(v);
+	}
 
-	// CPU to OPS interface
-	void setAlgorithm(uint8_t mode, uint8_t algo) { ops.setAlgorithm(mode, algo); }
+	// Output the 16 subsamples of each sample, unfiltered (set before
+	// rendering anything)
+	void subsamples(bool v) { subsamples_ = v; }
+	int stride() const { return subsamples_ ? 16 : 1; } // Floats per sample
+
+	// Instruction set of the DSP kernels, see Dispatch.h
+	void isa(Isa i) { isa_ = i; ops.isa(i); }
+
+	// CPU interface: writes to 0x30** (with the next byte, for 16 bit
+	// stores), and to the OPS algorithm register 0x2805 (with 0x2804)
+	void write(uint8_t addr, uint8_t data, uint8_t next) { record(Write{batch->ticks, addr, {data, next}}); }
+	void setAlgorithm(uint8_t mode, uint8_t algo) { record(Write{batch->ticks, Algorithm, {mode, algo}}); }
+
+	// Run-ahead
+	// Rather than clocking the EGS and OPS after each CPU step, clock() only
+	// counts the ticks, and the CPU's writes are logged with the tick they
+	// are due at. render() then clocks through the whole batch in one go,
+	// applying each write at its tick, which is bit exact with interleaving
+	// and keeps the CPU and DSP working sets apart.
+	static constexpr uint16_t Algorithm = 0x100;
+	struct Write {
+		uint32_t tick; // Since the start of the batch
+		uint16_t addr; // EGS register, or Algorithm
+		uint8_t data[2];
+	};
+	static constexpr int LogSize = 512;
+	struct Batch {
+		uint32_t ticks = 0; // To render
+		int logged = 0;
+		int8_t clean = -1; // Output mode from the start, if set
+		bool last = false; // Ends an audio block (see DX7Synth::pipeline)
+		Write log[LogSize];
+		void reset() { ticks = logged = 0; clean = -1; last = false; }
+	};
+
+	void runAhead(bool v) { runAhead_ = v; }
+	bool logFull() const { return batch->logged == LogSize; } // Render before the next step
+	int lagging() const { return (phase + batch->ticks)/96; } // Output samples not yet rendered
+	// Render the batch logged so far
+	void render(float *outbuf, int &count) {
+		render(*batch, outbuf, count);
+		phase = (phase + batch->ticks)%96;
+		batch->reset();
+	}
+	// Or hand it over to be rendered elsewhere, in order, and log to next
+	// from here. Adds the samples it will render to count.
+	Batch *handOff(Batch *next, int &count) {
+		Batch *b = batch;
+		count += lagging();
+		phase = (phase + b->ticks)%96;
+		next->reset();
+		batch = next;
+		return b;
+	}
+	// Render a batch. This and the logging only share the batch, so with
+	// the pipeline they run on different threads.
+	void render(const Batch &b, float *outbuf, int &count) {
+		if(b.clean >= 0) setClean(b.clean);
+#ifdef MULTI_ISA
+		// AVX-512 is only for the OPS kernels, see Dispatch.h
+		if(isa_ != Isa::Base) {
+			if(clean_) renderAVX2<true>(b, outbuf, count);
+			else renderAVX2<false>(b, outbuf, count);
+			return;
+		}
+#endif
+		if(clean_) render<true>(b, outbuf, count);
+		else render<false>(b, outbuf, count);
+	}
 
-	// Each clock tick computes one operator for one voice
-	// 6x16=96 ticks generates one audio output sample
-	// at DX7 native SR 49.096khz
-	// Returns output samples in outbuf and increments buffer index count
-	void INLINE clock(float* outbuf, int &count, int cycles) {
-		for(int i=0; i<cycles; i++) {
+private:
+	Batch own;
+	Batch *batch = &own; // Being logged
+	int phase = 0; // Tick in the output sample the batch starts at
+	bool runAhead_ = false;
+
+	void record(const Write &w) {
+		if(runAhead_) batch->log[batch->logged++] = w;
+		else apply(w);
+	}
+	void apply(const Write &w) {
+		if(w.addr == Algorithm) {
+			wakeAll();
+			ops.setAlgorithm(w.data[0], w.data[1]);
+			return;
+		}
+		regs[w.addr] = w.data[0];
+		if(w.addr < 0xFF) regs[w.addr+1] = w.data[1];
+		update(w.addr);
+	}
 
-			// Advance envelope
-			uint16_t e = env[currOp][currVoice].getsample();
+#ifdef MULTI_ISA
+	template<bool clean> TARGET_AVX2 void renderAVX2(const Batch &b, float *outbuf, int &count) { render<clean>(b, outbuf, count); }
+#endif
+	template<bool clean> void INLINE render(const Batch &b, float *outbuf, int &count) {
+		uint32_t done = 0;
+		for(int i=0; i<b.logged; i++) {
+			clock<clean>(outbuf, count, b.log[i].tick - done);
+			done = b.log[i].tick;
+			apply(b.log[i]);
+		}
+		clock<clean>(outbuf, count, b.ticks - done);
+	}
 
-			// Amplitude modulation
-			int ampModSens = (opSensScale[currOp]>>3);
+public:
 
-			// Based on comparison to an audio track in Massey's book,
-			// amp mode sensitivity shifts the ampmod value as follows:
-			if(ampModSens) e += ampMod<<ampModSens; // No modulation when ampModSens==0
+	// Advance the envelopes of one operator for voices [from, to)
+	void INLINE clockEnvelopes(int op, int from, int to) {
+		env[op].getsamples(from, to);
 
-			if(e>0xFFF) e = 0xFFF;
-			envelope[currOp][currVoice] = e;
+		// Amplitude modulation
+		int ampModSens = (opSensScale[op]>>3);
 
-			// Run OPS
-			ops.clock(currOp, currVoice);
+		// Based on comparison to an audio track in Massey's book,
+		// amp mode sensitivity shifts the ampmod value as follows:
+		uint16_t am = ampModSens ? ampMod<<ampModSens : 0; // No modulation when ampModSens==0
 
-			// Increment voice and op
-			if(++currVoice == 16) {
+		for(int v=from; v<to; v++) {
+			uint16_t e = env[op].level[v] + am;
+			envelope[op][v] = e>0xFFF ? 0xFFF : e;
+		}
+	}
+
+	// Each clock tick computes one operator for one voice
+	// 6x16=96 ticks generates one audio output sample
+	// at DX7 native SR 49.096khz
+	// Returns output samples in outbuf and increments buffer index count,
+	// or with run-ahead, leaves them to render()
+	// The output mode and instruction set are chosen once per render, so
+	// clean() takes effect from the next one.
+	void INLINE clock(float* outbuf, int &count, int cycles) {
+		batch->ticks += cycles;
+		if(!runAhead_) render(outbuf, count);
+	}
+	template<bool clean> void INLINE clock(float* outbuf, int &count, int cycles) {
+		for(int i=0; i<cycles; ) {
+			// The voices of an op are independent, so all of them the ticks
+			// reach can be run together
+			int from = currVoice, to = min(16, currVoice + cycles - i);
+			clockEnvelopes(currOp, from, to);
+			uint16_t run = ops.clock(currOp, from, to, ~sleeping) & sleeping;
+			for(int v=0; run; v++, run>>=1) if(run & 1) synced[currOp][v]++; // Not skipped
+			i += to - from;
+			currVoice = to;
+
+			// Next op
+			if(currVoice == 16) {
 				currVoice = 0;
 				if(++currOp == 6) {
 					// Output after all 16x6 ops are computed
 					// Apply S-K filter and decimate
-					outbuf[count++] = filter(ops.out);
+					if(subsamples_) subsamples(ops.out, outbuf + 16*count++);
+					else outbuf[count++] = filter<clean>(ops.out);
 					currOp = 0;
 					env_clock++; // increment envelope clock
+					if(!(++samples & 31)) sleep();
 				}
 			}
 		}
@@ -280,20 +553,22 @@ public:
 			case 0:
 				if(ADDR&0x01) { updateVoicePitch(ADDR>>1); return; }
 			case 1:
-				if(ADDR&0x01) { updateOpPitch((ADDR&0x0F)>>1); return; }
-				return; // also catches detune
+				if(ADDR&0x01) updateOpPitch((ADDR&0x0F)>>1);
+				if(ADDR>=0x30 && ADDR<0x36) updateOpBase(ADDR-0x30); // Detune
+				return;
 			case 2:
 				if((ADDR>=0x40) && (ADDR<0x57)) {
 					if((ADDR&0x03)!=3) return; // only update on fourth rate
 					uint8_t op = (ADDR - 0x40)>>2;
-					for(int voice=0; voice<16; voice++) env[op][voice].updateRate();
+					for(int voice=0; voice<16; voice++) env[op].updateRate(voice);
 				}
 				return;
 			case 3:
 				if((ADDR>=0x60) && (ADDR<0x77)) {
 					if((ADDR&0x03)!=3) return; // only update on fourth level
 					uint8_t op = (ADDR - 0x60)>>2;
-					for(int voice=0; voice<16; voice++) env[op][voice].updateLevel();
+					wakeAll();
+					for(int voice=0; voice<16; voice++) env[op].updateLevel(voice);
 				}
 				return;
 			case 4:
@@ -303,6 +578,7 @@ public:
 			case 7:
 				if(ADDR>=0xE0 && ADDR <=0xE5) {
 					uint8_t op = ADDR-0xE0;
+					wakeAll(); // Amp mod sensitivity
 					for(int voice=0; voice<16; voice++) updateRateScaling(voice, op);
 				}
 				else if(ADDR==0xF3) { updatePitchMod(); return; }
@@ -316,60 +592,58 @@ private:
 	void updateVoiceEvents() {
 		uint8_t voice = voiceEvents>>2;
 		bool keyon = voiceEvents&1; // bit 0 is keyon, bit 1 is keyoff
+		wake(voice);
 		for(int op=0; op<6; op++) {
-			if(keyon) env[op][voice].key_on();
-			else env[op][voice].key_off();
+			if(keyon) env[op].key_on(voice);
+			else env[op].key_off(voice);
 		}
 		if(keyon) ops.keyOn(voice);
 	}
 
 	void updateRateScaling(uint8_t voice, uint8_t op) {
-		// Rate Scaling
-		// Per the (linear) graph in the user manual:
-		//                  rateScaling:  7  6  5  4  3  2  1  0
-		//  A(-1) (midi  21, 27.5Hz)  ->  0  0  0  0  0  0  0  0 
-		//  F#(7) (midi 102, 2960Hz)  -> 42 36 30 24 18 12  6  0
-		//  (in 0-99 rate units, with rate=qrate*64/41
-		// The function below replicates this table in qrate units
-		// using note frequencies in voicePitch units.
-		// In hardware this is surely a ROM lookup table
-		int rateScaling = opSensScale[op]&0x7;
-		uint16_t rs = int (min(27,max(0,(voicePitch[voice]>>8)-16))*rateScaling/7.0 + 0.5);
-		env[op][voice].ratescaling = rs;
+		env[op].ratescaling[voice] = rateScaling[opSensScale[op]&0x7][voicePitch[voice]>>8];
 	}
 
 	// Update voice pitch registers on CPU write
 	void updateVoicePitch(uint8_t voice) {
 		voicePitch[voice] = (mem[2*voice]<<8 | mem[2*voice+1])>>2;
+		for(int op=0; op<6; op++) freqBase[op][voice] = opBase[op] + (ratio[op] & voicePitch[voice]);
 		updateFrequency(voice);
 		for(int op=0; op<6; op++) updateRateScaling(voice, op);
 	}
 
 	// Update op pitch registers on CPU write
-	void updateOpPitch(uint8_t op) { opPitch[op] = mem[0x20+2*op]<<8 | mem[0x20+2*op+1]; }
+	void updateOpPitch(uint8_t op) {
+		opPitch[op] = mem[0x20+2*op]<<8 | mem[0x20+2*op+1];
+		if(op<6) updateOpBase(op);
+	}
+
+	// Op pitch and detune, and ratio or fixed
+	void updateOpBase(uint8_t op) {
+		opBase[op] = opPitch[op]>>2;
+		opBase[op] += opDetune[op]&0x8 ? -int16_t(opDetune[op]&0x7) : opDetune[op];
+		ratio[op] = opPitch[op]&1 ? 0 : -1;
+		for(int voice=0; voice<16; voice++) freqBase[op][voice] = opBase[op] + (ratio[op] & voicePitch[voice]);
+	}
 
 	// Pitchmod is 4x voice (16x 14 bit voice (>>2))
 	// Strictly speaking the uint16 to int16 conversion is UB
 	// before C++20, but works fine on all common machines
 	void updatePitchMod() {
 		pitchMod = int16_t(mem[0xF2]<<8 | mem[0xF3])/16;
-		for(int voice=0; voice<16; voice++) updateFrequency(voice);
+		for(int voice=0; sleeping>>voice; voice++) if(sleeping>>voice & 1) catchUp(voice); // At the old frequency
+		for(int op=0; op<6; op++) {
+			int32_t mod = ratio[op] & pitchMod;
+			for(int voice=0; voice<16; voice++) frequency[op][voice] = clamp(freqBase[op][voice] + mod);
+		}
 	}
 
 	// Update frequency (pitch) for OPS
 	void updateFrequency(uint8_t voice) {
-		for(int op=0; op<6; op++) {
-			int32_t f = opPitch[op]>>2;
-			f += opDetune[op]&0x8 ? -int16_t(opDetune[op]&0x7) : opDetune[op];
-			if(!(opPitch[op]&1)) { // Ratio
-				f += voicePitch[voice];
-				f += pitchMod;
-			} // else Fixed
-			// Clamp
-			if(f>0x3FFF) f=0x3FFF; else if(f<0) f=0;
-			frequency[op][voice] = f;
-		}
+		if(sleeping>>voice & 1) catchUp(voice); // At the old frequency
+		for(int op=0; op<6; op++) frequency[op][voice] = clamp(freqBase[op][voice] + (ratio[op] & pitchMod));
 	}
+	static int32_t clamp(int32_t f) { return f>0x3FFF ? 0x3FFF : f<0 ? 0 : f; }
 
 	// Utilities
 	int max(int x, int y) { return x>y ? x : y; }
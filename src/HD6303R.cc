@@ -17,35 +17,124 @@
 **/
 
 #include "HD6303R.h"
+#ifdef PROFILE
+#include <algorithm>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t ticks() { return __rdtsc(); }
+#else
+#include <chrono>
+static inline uint64_t ticks() { return std::chrono::steady_clock::now().time_since_epoch().count(); }
+#endif
+#endif
 
 void HD6303R::step() {
 	if(halt) return;
 
-	opcode = memory[PC++];
-	inst = instructions+opcode;
-
 	OP = OP2 = ADDR = 0; // Need to reset for OCR and P_ACEPT
-
-	if(inst->mode == 0) { // Illegal opcode
-		fprintf(stderr, "Illegal opcode %02X PC=%04X\n", opcode, PC);
-		trap();
-		return;
+#ifdef PROFILE
+	fuseLimit = 0; // One instruction per step
+	uint16_t pc = PC, routine = profileRoutine();
+	uint64_t t = ticks();
+#endif
+#ifdef TRACE
+	if(tracer) fuseLimit = 0; // One instruction per record
+	TraceRecord r;
+	r.cycle = cycle;
+	r.pc = PC;
+#endif
+	int limit = fuseLimit;
+	if(idleStep >= 0) fuseLimit = 0; // Single steps while recording an idle loop
+
+	// Run the instruction: a native routine or the recompiled firmware if
+	// the host lets it run ahead, or the translation cache if in ROM, or
+	// interpreted. The registers are synced first if the instruction may
+	// access them.
+	if(!(fuseLimit > 0 && ((PC >= ROM && routineAt[PC-ROM] && stepRoutine())
+			|| (native && stepNative())))) {
+		const UOp *u = PC >= ROM && cacheROM ? &romCache[PC-ROM] : 0;
+		if(u && !u->bytes) {
+			decodeBlock(PC);
+			if(!u->bytes) u = 0; // Illegal
+		}
+		if(u) {
+			if(!(u->fuse && u->info.cycles < fuseLimit && stepFused(*u))) {
+				inst = &u->info;
+				opcode = u->opcode;
+				if(u->regs && (!u->indexed || uint16_t(IX + (u->operand&0xFF)) < 0x20)) syncRegs();
+				execute(*u);
+			}
+		} else {
+			opcode = memory[PC++];
+			inst = &instInfo[opcode];
+
+			if(!inst->legal) { // Illegal opcode
+				fprintf(stderr, "Illegal opcode %02X PC=%04X\n", opcode, PC);
+				trap();
+				return;
+			}
+
+			syncRegs();
+			execute();
+		}
 	}
 
-	// Save these
-	uint8_t saveTCSR = TCSR, saveTRCSR = TRCSR;
-
-	// Run the instruction
-	inst->action();
+#ifdef PROFILE
+	if(opcode == 0x8D || opcode == 0x9D || opcode == 0xAD || opcode == 0xBD) profileCall(cycle + inst->cycles); // bsr, jsr
+	else if(opcode == 0x39 || opcode == 0x3B) profileReturn(cycle + inst->cycles); // rts, rti
+#endif
 
-	// Top 3 bits of TCSR and TRCSR are read-only, so fix if written to
-	if(saveTCSR != TCSR) TCSR = (TCSR&0x1F) | (saveTCSR&0xE0);
-	if(saveTRCSR != TRCSR) TRCSR = (TRCSR&0x1F) | (saveTRCSR&0xE0);
+	// At the head of a loop, or recording a pass through one
+	if(idleStep >= 0 || (opcode == 0x20 && int8_t(OP) < 0 && skipIdle)) idleLoop(limit);
 
 	// Clock update
+	uint32_t p_timer1 = uint16_t(cycle - frcBase); // Previous counter value in FRC
 	cycle += inst->cycles;
-	sci_tx_counter += inst->cycles;
-	sci_rx_counter += inst->cycles;
+
+	// Nothing else to do before the next event, unless the registers were
+	// accessed (ADDR is 0 if no memory was, and P1DDR has no side effects)
+	bool regs = uint16_t(ADDR-1) < 0x1F;
+	if(cycle >= nextEvent || regs) events(regs, p_timer1);
+
+	// Memory mapped devices
+	if(inst->w) {
+		WriteHook hook = writeHook[ADDR>>8];
+		if(hook) (this->*hook)(ADDR);
+	}
+
+#ifdef PROFILE
+	t = ticks() - t;
+	Profile &p = profile[pc];
+	p.count++;
+	p.cycles += inst->cycles;
+	p.ticks += t;
+	profile[routine].self += inst->cycles;
+	profile[routine].selfTicks += t;
+#endif
+
+#ifdef TRACE
+	if(tracer) {
+		r.operand = memory[uint16_t(r.pc+1)]<<8 | memory[uint16_t(r.pc+2)];
+		r.addr = ADDR;
+		r.ix = IX;
+		r.sp = SP;
+		r.opcode = opcode;
+		r.a = A;
+		r.b = B;
+		r.ccr = getCCR();
+		tracer->record(r);
+	}
+#endif
+}
+
+// Timer, SCI and interrupt processing, at an event or after an
+// instruction accessed the registers
+void HD6303R::events(bool regs, uint32_t p_timer1) {
+	// Top 3 bits of TCSR and TRCSR are read-only, so fix if written to
+	if(regs && inst->w) {
+		TCSR = (TCSR&0x1F) | (saveTCSR&0xE0);
+		TRCSR = (TRCSR&0x1F) | (saveTRCSR&0xE0);
+	}
 
 	// Handle external IRQ
 	if(!irqpin) irq();
@@ -53,9 +142,9 @@ void HD6303R::step() {
 	///////////////////////////////////////
 	// Timer 1 interrupt processing
 	///////////////////////////////////////
-	uint32_t p_timer1 = getm16(0x09); // Previous counter value in FRCH
+	if(regs) p_timer1 = getm16(0x09); // May have been written
 	uint32_t timer1 = p_timer1 + inst->cycles; // New counter value
-	stom16(0x09, timer1&0xFFFF); // handle wrap, and update
+	frcBase = cycle - (timer1&0xFFFF); // handle wrap, and update
 
 	// Timer1 OCR match handling
 	uint32_t ocr = getm16(0x0B);
@@ -97,23 +186,35 @@ void HD6303R::step() {
 	// Transmit: Write to TDR after read of TRCSR
 	if(ADDR == 0x13 && readTRCSR && inst->w) {
 		clear(TRCSR, TDRE); // Clear TDRE
-		sci_tx_counter = 0; // reset timer
+		sci_tx_start = cycle; // reset timer
 	}
 
 	// Receive: Read of RDR after read of TRCSR
 	if(ADDR == 0x12 && readTRCSR && inst->r) {
 		clear(TRCSR, RDRF); // Clear RDRF
 		clear(TRCSR, ORFE); // Clear ORFE
-		sci_rx_counter = 0; // reset timer
+		sci_rx_start = cycle; // reset timer
 	}
 
 	// Read of TRCSR sets flag
 	if(ADDR==0x11 && inst->r) readTRCSR = true;
 
 	// Trigger SCI interrupt request if TE && TIE && TDRE || RE && RIE && RDRF
-	constexpr const uint8_t mask1 = 1<<TDRE | 1<<TIE | 1<<TE;
-	constexpr const uint8_t mask2 = 1<<RDRF | 1<<RIE | 1<<RE;
-	if((TRCSR & mask1) == mask1 || (TRCSR & mask2) == mask2) sci();
+	if(sciRequest()) sci();
+
+	schedule();
+}
+
+// Next event after this step: the OCR match, or the FRC wrap (the
+// match is only checked within a step), or the next step if an
+// interrupt request is pending
+void HD6303R::schedule() {
+	if(!irqpin || (bit(TCSR,OCF) && bit(TCSR,EOCI)) || sciRequest()) {
+		nextEvent = cycle;
+		return;
+	}
+	uint32_t frc = uint16_t(cycle - frcBase), ocr = getm16(0x0B);
+	nextEvent = cycle + (ocr > frc ? ocr - frc : 0x10000 - frc);
 }
 
 // Sender waits the appropriate baud rate as measured by sci_rx_counter, then calls
@@ -125,6 +226,7 @@ void HD6303R::clockInData(uint8_t byte) {
 	if(bit(TRCSR, RDRF)) set(TRCSR, ORFE); // ORFE overrun
 	set(TRCSR, RDRF); // Set RDRF
 	readTRCSR = false;
+	nextEvent = 0; // May request an interrupt
 }
 
 // Receiver waits the appropriate baud rate as measured by sci_tx_counter, then calls
@@ -135,6 +237,7 @@ bool HD6303R::clockOutData(uint8_t& byte) {
 	if(!bit(TRCSR, TDRE)) {
 		set(TRCSR, TDRE); // Set TDRE, CPU can send another byte
 		readTRCSR = false;
+		nextEvent = 0; // May request an interrupt
 		byte = TDR;
 		return true;
 	} else return false;
@@ -158,6 +261,8 @@ void HD6303R::reset() {
 	RDR    = 0x00;
 	TDR    = 0x00;
 	RAMCR  = 0x14;
+	frcBase = cycle;
+	nextEvent = 0;
 
 	// Set PC to reset vector
 	PC = getm16(0xFFFE);
@@ -186,6 +291,7 @@ bool HD6303R::maskable_interrupt(uint16_t vector) {
 }
 
 void HD6303R::interrupt(uint16_t vector) {
+	idleStep = -1; // Not an idle loop pass
 	push(PC);
 	push(IX);
 	memory[SP--] = A;
@@ -194,6 +300,16 @@ void HD6303R::interrupt(uint16_t vector) {
 	I = 1;
 	PC = memory[vector] << 8;
 	PC |= memory[vector+1];
+#ifdef PROFILE
+	profileCall(cycle);
+#endif
+}
+
+// FNV-1a hash of the ROM, to recognise a firmware
+uint32_t HD6303R::romHash() {
+	uint32_t hash = 2166136261u;
+	for(int a=ROM; a<0x10000; a++) hash = (hash ^ memory[a]) * 16777619u;
+	return hash;
 }
 
 // Load a program from file
@@ -216,6 +332,7 @@ int HD6303R::pgmload(const char *f) {
 		return(-3);
 	}
 	fclose(fp);
+	invalidate(start, 0xFFFF);
 
 	// reset vector
 	reset();
@@ -242,6 +359,7 @@ int HD6303R::memload(const char *f, uint16_t addr) {
 		return(-3);
 	}
 	fclose(fp);
+	invalidate(start, start+size-1);
 	return(0);
 }
 
@@ -260,9 +378,102 @@ int HD6303R::memsave(const char *f, uint16_t addr, uint16_t bytes) {
 
 // Debug tracing
 void HD6303R::trace() {
+	flags();
 	printf("%016lX inst=%02X %4s %2s OP=%02X OP2=%04X ADDR=%04X "
 		"A=%02X B=%02X CCR=%d%d%d%d%d%d SP=%04X IX=%04X PC=%04X ",
 		cycle, opcode, instructions[opcode].op, instructions[opcode].mode, OP, OP2, ADDR,
 		A, B, H, I, N, Z, V, C, SP, IX, PC);
 }
 
+
+#ifdef TRACE
+// Record every instruction to file f, until traceStop()
+int HD6303R::traceStart(const char *f) {
+	tracer.reset(new Tracer);
+	int err = tracer->start(f);
+	if(err) tracer.reset();
+	return(err);
+}
+#endif
+
+#ifdef PROFILE
+// Enter the routine at PC, called from the current one
+void HD6303R::profileCall(uint64_t at) {
+	profile[PC].calls++;
+	profileEdges[uint32_t(profileRoutine())<<16 | PC].calls++;
+	profileStack.push_back(Frame{PC, SP, at});
+}
+
+// Leave the routines whose stack frames were popped
+void HD6303R::profileReturn(uint64_t at) {
+	while(!profileStack.empty() && profileStack.back().sp < SP) {
+		Frame f = profileStack.back();
+		profileStack.pop_back();
+		profile[f.entry].total += at - f.cycle;
+		profileEdges[uint32_t(profileRoutine())<<16 | f.entry].cycles += at - f.cycle;
+	}
+}
+
+// Write the call graph, then the code run as an annotated disassembly
+int HD6303R::profileDump(const char *f) {
+	FILE *fp = fopen(f, "w");
+	if(!fp) return(-1);
+
+	uint64_t count = 0, cycles = 0, ticks = 0;
+	int n = 0, bytes = 0; // Instructions and ROM bytes run
+	std::vector<uint16_t> entries{0};
+	for(int a=0; a<0x10000; a++) {
+		const Profile &p = profile[a];
+		count += p.count;
+		cycles += p.cycles;
+		ticks += p.ticks;
+		if(p.count) {
+			n++;
+			if(a >= ROM) bytes += instructions[memory[a]].bytes;
+		}
+		if(a && p.calls) entries.push_back(a);
+	}
+	profile[0].total = cycles;
+	std::sort(entries.begin(), entries.end(),
+		[this](uint16_t a, uint16_t b) { return profile[a].total > profile[b].total; });
+	double pct = cycles ? 100.0/cycles : 0;
+
+	fprintf(fp, "%lu instructions, %lu cycles, %lu ticks\n", count, cycles, ticks);
+	fprintf(fp, "Coverage: %d instructions, %d of %d ROM bytes (%.1f%%)\n\n",
+		n, bytes, 0x10000-ROM, 100.0*bytes/(0x10000-ROM));
+
+	// Routines by cycles including callees, each with its callees
+	fprintf(fp, "Routine      calls      cycles      %%        self      %%   self ticks\n");
+	for(uint16_t e : entries) {
+		const Profile &p = profile[e];
+		if(e) fprintf(fp, "%04X   ", e);
+		else fprintf(fp, "(top)  ");
+		fprintf(fp, "%10lu %11lu %6.2f %11lu %6.2f %12lu\n",
+			p.calls, p.total, p.total*pct, p.self, p.self*pct, p.selfTicks);
+		auto end = profileEdges.lower_bound(uint32_t(e+1)<<16);
+		for(auto i = profileEdges.lower_bound(uint32_t(e)<<16); i != end; ++i) {
+			fprintf(fp, "  -> %04X %10lu %11lu %6.2f\n",
+				i->first & 0xFFFF, i->second.calls, i->second.cycles, i->second.cycles*pct);
+		}
+	}
+
+	// Annotated disassembly, with routine entries labelled
+	fprintf(fp, "\nAddr  Instruction          count      cycles      %%        ticks\n");
+	for(int a=0, next=-1; a<0x10000; a++) {
+		const Profile &p = profile[a];
+		if(!p.count) continue;
+		if(next >= 0 && a != next) fprintf(fp, "      ...\n");
+		if(p.calls) fprintf(fp, "%04X: (%lu calls, %lu cycles)\n", a, p.calls, p.total);
+		const Instruction &i = instructions[memory[a]];
+		char operand[8] = "";
+		if(i.bytes == 2) sprintf(operand, "$%02X", memory[uint16_t(a+1)]);
+		else if(i.bytes == 3) sprintf(operand, "$%02X%02X", memory[uint16_t(a+1)], memory[uint16_t(a+2)]);
+		fprintf(fp, "%04X  %.4s %2s %-6s %11lu %11lu %6.2f %12lu\n",
+			a, i.op, i.mode, operand, p.count, p.cycles, p.cycles*pct, p.ticks);
+		next = a + i.bytes;
+	}
+
+	if(fclose(fp)) return(-2);
+	return(0);
+}
+#endif
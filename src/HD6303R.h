@@ -20,10 +20,18 @@
 #include <cstdio>
 #include <cstdint>
 #include <endian.h>
-#include <functional>
+#include <array>
+#include <vector>
+#ifdef PROFILE
+#include <map>
+#endif
+#ifdef TRACE
+#include <memory>
+#include "Trace.h"
+#endif
 
 struct HD6303R {
-	HD6303R() { initInst(); }
+	HD6303R() { for(int p=ROM>>8; p<0x100; p++) writeHook[p] = &HD6303R::romWrite; }
 
 	// Registers /////////////////////////////////////
 	union {
@@ -38,6 +46,18 @@ struct HD6303R {
 	};
 
 	bool H, I, N, Z, V, C;
+	enum { fC=0x01, fV=0x02, fZ=0x04, fN=0x08, fH=0x20 }; // CCR flag masks
+#ifdef LAZY_FLAGS
+	// Lazy condition codes: the flags in lazyMask are not in H,N,Z,V,C yet,
+	// and are evaluated from the last operation that set them when read
+	enum { ADD, SUB, LOGIC, DEC, INC };
+	uint8_t lazyOp=0, lazyMask=0;
+	uint16_t lazy1=0, lazy2=0, lazyR=0, lazySign=0; // Operands, result, sign bit
+	inline void flags(uint8_t mask = fH|fN|fZ|fV|fC); // Evaluate pending flags
+	inline void lazy(uint8_t op, uint8_t mask, uint16_t op1, uint16_t op2, uint16_t r, uint16_t sign);
+#else
+	void flags(uint8_t mask = 0) { } // Always up to date
+#endif
 	uint16_t IX=0, SP=0;
 	uint16_t PC=0x0000;
 
@@ -77,6 +97,20 @@ struct HD6303R {
 	void crash() { halt = true; }
 	bool halt = false;
 	uint64_t cycle = 0;
+	// Next event scheduler. Until cycle reaches nextEvent (an OCR match or
+	// FRC wrap, or now if an interrupt request is pending), an instruction
+	// that doesn't access the on-chip registers only counts its cycles.
+	// FRC is stored to memory only for an instruction that may read it.
+	uint64_t nextEvent = 0;
+	uint64_t frcBase = 0; // FRC = cycle - frcBase
+	uint8_t saveTCSR = 0, saveTRCSR = 0; // Read-only bits, restored if written
+	void syncRegs() { // Before an instruction that may access the registers
+		stom16(0x09, uint16_t(cycle - frcBase));
+		saveTCSR = TCSR;
+		saveTRCSR = TRCSR;
+	}
+	void schedule();
+	void events(bool regs, uint32_t p_timer1);
 	bool readTCSR=false;
 	bool wroteOCR=false;
 	bool readTRCSR=false;
@@ -85,7 +119,7 @@ struct HD6303R {
 	// Called externally
 	void clockInData(uint8_t byte);
 	bool clockOutData(uint8_t& byte);
-	uint32_t sci_tx_counter = 0, sci_rx_counter = 0; // serial baud timers
+	uint64_t sci_tx_start = 0, sci_rx_start = 0; // serial baud timers run from these cycles
 
 
 	// Interrupts //////////////////////////////////
@@ -99,32 +133,155 @@ struct HD6303R {
 	bool irq2();
 	bool sci();
 	void trap();
+	bool sciRequest() { // TE && TIE && TDRE || RE && RIE && RDRF
+		constexpr const uint8_t mask1 = 1<<TDRE | 1<<TIE | 1<<TE;
+		constexpr const uint8_t mask2 = 1<<RDRF | 1<<RIE | 1<<RE;
+		return (TRCSR & mask1) == mask1 || (TRCSR & mask2) == mask2;
+	}
 	bool maskable_interrupt(uint16_t vector);
 	void interrupt(uint16_t vector); // generic state save routine
 	void reset();
 	bool irqpin = true; // NB active low
 
 	// Instructions ////////////////////////////////
+	// Disassembly metadata, only needed for tracing and debugging
 	struct Instruction {
-		Instruction() = default;
-		Instruction( uint8_t opcode, const char *group, const char *op,
-				const char* mode, bool r, bool w, int bytes, int cycles,
-				std::function<void()> action
-			) :
-				opcode(opcode), group(group), op(op), mode(mode),
-				r(r), w(w), bytes(bytes), cycles(cycles), action(action)
-			{ }
-
 		uint8_t opcode=0;
 		const char *group="", *op=""; // Nmemonics
 		const char *mode = 0; // Address mode
 		bool r=0, w=0; // read or write
 		int bytes=0, cycles=0; // instr length and time
-		std::function<void()> action=0; // code
 	};
-	Instruction instructions[256];
-	void initInst();
-	Instruction* inst=0; // Current instruction
+	static const std::array<Instruction, 256> instructions;
+
+	// Execution data, kept apart from the metadata so the table
+	// touched on every instruction fits in a few cache lines
+	struct InstInfo {
+		uint16_t cycles=0; // instr time (more if fused or fast-forwarded)
+		bool r=0, w=0; // read or write
+		bool legal=0;
+	};
+	static const std::array<InstInfo, 256> instInfo;
+	const InstInfo* inst=0; // Current instruction
+
+	// Run the current opcode, dispatched by switch or computed goto
+	void execute();
+	// Run opcode op with its operand bytes already fetched
+	template<uint8_t op> inline void exec(uint16_t operand);
+
+	// ROM translation cache ///////////////////////
+	// The firmware ROM is read-only, so its code is decoded once, a basic
+	// block at a time, into micro-ops with the operand bytes pre-assembled.
+	// Adjacent pairs that can safely run as one step (e.g. compare and
+	// branch) are flagged as fused. A pair is only fused when nothing could
+	// observe the boundary between them: the CPU checks its own interrupts
+	// and timer, and the host grants fuseLimit for everything else.
+	static constexpr uint16_t ROM = 0xC000;
+	struct UOp {
+		uint16_t operand=0; // operand bytes, big endian
+		InstInfo info;
+		uint8_t opcode=0;
+		uint8_t bytes=0; // 0 if not decoded
+		bool fuse=false; // may run together with the next micro-op
+		bool indexed=false;
+		bool regs=false; // accesses the on-chip registers, or may if indexed
+	};
+	UOp romCache[0x10000-ROM];
+	bool cacheROM = true;
+	int fuseLimit = 0; // Host allows fusing if the first instruction takes fewer cycles
+	void invalidate(uint16_t lo, uint16_t hi); // Call if ROM memory is modified
+	void decodeBlock(uint16_t pc);
+	bool stepFused(const UOp& u);
+	void romWrite(uint16_t addr);
+	void execute(const UOp& u); // Run a decoded micro-op
+	InstInfo fusedInfo;
+
+	// Memory mapped devices /////////////////////
+	// Write hooks by 256 byte page: after an instruction writes memory,
+	// step() calls the hook of the page it wrote, if any, with the address.
+	// RAM pages have none, and the on-chip registers are handled by step().
+	typedef void (HD6303R::*WriteHook)(uint16_t addr);
+	WriteHook writeHook[0x100] = {};
+
+	// Idle loops ///////////////////////////////////
+	// The firmware's main loop polls for work that only an interrupt or the
+	// host can bring. The target of a backward BRA is taken as a loop head,
+	// and two passes through the loop are recorded one instruction at a
+	// time. If they are identical and only touched plain RAM, the state at
+	// the head is a fixed point, and while the registers and the memory the
+	// passes accessed are unchanged, a step arriving there adds whole passes
+	// of cycles, within fuseLimit and before the next event.
+	bool skipIdle = true;
+	struct IdleStep { uint64_t regs, mem; }; // State after an instruction
+	static constexpr int IdleSteps = 64; // Longest pass
+	IdleStep idlePass[2][IdleSteps];
+	int idleStep = -1; // Instructions recorded in this pass, -1 if not recording
+	int idlePasses = 0, idleCycles = 0; // Passes recorded, and cycles of this one
+	int idlePrev = 0; // Instructions in the last pass
+	uint16_t idleHead = 0;
+	int idleLength = 0; // Cycles of a pass, if the head is a fixed point
+	uint16_t idleAddr[4*IdleSteps]; // Memory the passes accessed
+	uint8_t idleData[4*IdleSteps]; // and its value at the head
+	int idleN = 0;
+	uint64_t idleRetry = 0; // Cycle to try again after a failed recording
+	int idleBackoff = 1024;
+	uint64_t idleRegs = 0; // At the head
+	uint64_t packRegs() { return A | B<<8 | getCCR()<<16 | uint64_t(IX)<<24 | uint64_t(SP)<<40; }
+	void idleLoop(int limit);
+	bool idleSkip(int limit);
+	void idleFail();
+
+	// High level emulation ////////////////////////
+	// Hot firmware routines can be replaced by native code, installed by the
+	// machine only for the ROM it was written for (see romHash()). A step
+	// that starts at a routine's entry, if the host lets it run ahead, runs
+	// the routine instead: it carries on from PC to a point of its choosing,
+	// with the same effect on the registers and memory as the interpreter,
+	// sets opcode to its last instruction's, and returns the cycles taken.
+	// It returns 0, having changed nothing, if they would be more than max.
+	// Like a fused step, a routine must only access plain RAM.
+	typedef int (HD6303R::*Routine)(int max);
+	std::vector<Routine> routines{nullptr};
+	uint8_t routineAt[0x10000-ROM] = {}; // Index in routines, 0 if none
+	bool lockstep = false; // Validate routines against the interpreter
+	uint32_t romHash(); // FNV-1a of the ROM
+	void addRoutine(uint16_t pc, Routine r);
+	bool stepRoutine();
+	int checkRoutine(Routine r, int max);
+
+	// Statically recompiled firmware, see rom2cc.cc
+	bool native = false; // Run the recompiled code
+	bool nativeROM(); // True if the ROM is the one that was recompiled
+	bool stepNative(); // Returns false if PC is not in recompiled code
+
+#ifdef PROFILE
+	// Profiler ////////////////////////////////////
+	// Every instruction is single stepped and counted by address, with its
+	// cycles and host time (TSC ticks where available). JSR, BSR and
+	// interrupts are calls, RTS and RTI returns, followed on a shadow stack
+	// to give each routine's cycles including its callees, and the call graph.
+	struct Profile {
+		uint64_t count=0, cycles=0, ticks=0; // Instructions at this address
+		uint64_t calls=0, total=0, self=0, selfTicks=0; // Routine entered here
+	};
+	struct Frame { uint16_t entry, sp; uint64_t cycle; };
+	struct Edge { uint64_t calls=0, cycles=0; };
+	std::vector<Profile> profile = std::vector<Profile>(0x10000);
+	std::vector<Frame> profileStack; // Routine 0 is the code outside any call
+	std::map<uint32_t, Edge> profileEdges; // By caller<<16 | callee
+	uint16_t profileRoutine() { return profileStack.empty() ? 0 : profileStack.back().entry; }
+	void profileCall(uint64_t at);
+	void profileReturn(uint64_t at);
+	int profileDump(const char *f);
+#endif
+
+#ifdef TRACE
+	// Instruction trace, see Trace.h. While a file is open every
+	// instruction is single stepped and recorded.
+	std::unique_ptr<Tracer> tracer;
+	int traceStart(const char *f);
+	void traceStop() { tracer.reset(); }
+#endif
 
 	// Decoding temps /////////////////////////////
 	uint8_t opcode;
@@ -155,6 +312,20 @@ struct HD6303R {
 	inline void index16();
 	inline void index3();
 
+	// Addressing modes for decoded instructions, with the operand
+	// bytes already fetched
+	inline void direct2(uint16_t operand);
+	inline void direct16(uint16_t operand);
+	inline void direct3(uint16_t operand);
+	inline void extend(uint16_t operand);
+	inline void extend16(uint16_t operand);
+	inline void immed2(uint16_t operand);
+	inline void immed3(uint16_t operand);
+	inline void implied(uint16_t operand);
+	inline void index2(uint16_t operand);
+	inline void index16(uint16_t operand);
+	inline void index3(uint16_t operand);
+
 	// Instruction helpers
 	inline void isleep();
 	inline void wait();
@@ -200,8 +371,32 @@ inline void HD6303R::push(uint16_t x) {
 	memory[SP--] = x>>8;
 }
 
+#ifdef LAZY_FLAGS
+inline void HD6303R::flags(uint8_t mask) {
+	mask &= lazyMask;
+	if(!mask) return;
+	lazyMask &= ~mask;
+	const uint16_t a = lazy1, b = lazy2, r = lazyR, s = lazySign;
+	if(mask & fN) N = r & s;
+	if(mask & fZ) Z = !r;
+	if(mask & fV) switch(lazyOp) {
+		case ADD: V = ( (a & b & ~r) | (~a & ~b & r) ) & s; break;
+		case SUB: V = ( (a & ~b & ~r) | (~a & b & r) ) & s; break;
+		case LOGIC: V = 0; break;
+		case DEC: V = (r == s-1); break;
+		case INC: V = (r == s); break;
+	}
+	if(mask & fC) { // ADD or SUB
+		if(lazyOp == ADD) C = ( (a & b) | (b & ~r) | (~r & a) ) & s;
+		else C = ( (~a & b) | (b & r) | (r & ~a) ) & s;
+	}
+	if(mask & fH) H = ( (a & b) | (b & ~r) | (~r & a) ) & (1<<3); // 8 bit ADD
+}
+#endif
+
 // Get and set CCR flags to/from a byte
 inline uint8_t HD6303R::getCCR() {
+	flags();
 	uint8_t ccr = 0xC0;
 	if(H) ccr |= (1<<5);
 	if(I) ccr |= (1<<4);
@@ -213,6 +408,9 @@ inline uint8_t HD6303R::getCCR() {
 }
 
 inline void HD6303R::setCCR(uint8_t ccr) {
+#ifdef LAZY_FLAGS
+	lazyMask = 0;
+#endif
 	H = ccr&(1<<5);
 	I = ccr&(1<<4);
 	N = ccr&(1<<3);
@@ -16,444 +16,353 @@
  *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
 **/
 
-#include "HD6303R.h"
-
-void HD6303R::initInst() {
-	Instruction *r= instructions;
-	//        OP    GRP     INST    AM   R  W Byt Cyc Code
-	r[0x89]={0x89, "adc ", "adca", "im", 0, 0, 2,  2, [this]{ immed2  (); R=A+OP+C; A8(A,OP,R); A=R; }};
-	r[0x99]={0x99, "adc ", "adca", "di", 1, 0, 2,  3, [this]{ direct2 (); R=A+OP+C; A8(A,OP,R); A=R; }};
-	r[0xa9]={0xa9, "adc ", "adca", "in", 1, 0, 2,  4, [this]{ index2  (); R=A+OP+C; A8(A,OP,R); A=R; }};
-	r[0xb9]={0xb9, "adc ", "adca", "ex", 1, 0, 3,  4, [this]{ extend  (); R=A+OP+C; A8(A,OP,R); A=R; }};
-	r[0xc9]={0xc9, "adc ", "adcb", "im", 0, 0, 2,  2, [this]{ immed2  (); R=B+OP+C; A8(B,OP,R); B=R; }};
-	r[0xd9]={0xd9, "adc ", "adcb", "di", 1, 0, 2,  3, [this]{ direct2 (); R=B+OP+C; A8(B,OP,R); B=R; }};
-	r[0xe9]={0xe9, "adc ", "adcb", "in", 1, 0, 2,  4, [this]{ index2  (); R=B+OP+C; A8(B,OP,R); B=R; }};
-	r[0xf9]={0xf9, "adc ", "adcb", "ex", 1, 0, 3,  4, [this]{ extend  (); R=B+OP+C; A8(B,OP,R); B=R; }};
-	r[0x1b]={0x1b, "add ", "aba ", "id", 0, 0, 1,  1, [this]{ implied (); R=A+B; A8(A,B,R); A=R; }};
-	r[0x3a]={0x3a, "add ", "abx ", "id", 0, 0, 1,  1, [this]{ implied (); IX+=B; }};
-	r[0x8b]={0x8b, "add ", "adda", "im", 0, 0, 2,  2, [this]{ immed2  (); R=A+OP; A8(A,OP,R); A=R; }};
-	r[0x9b]={0x9b, "add ", "adda", "di", 1, 0, 2,  3, [this]{ direct2 (); R=A+OP; A8(A,OP,R); A=R; }};
-	r[0xab]={0xab, "add ", "adda", "in", 1, 0, 2,  4, [this]{ index2  (); R=A+OP; A8(A,OP,R); A=R; }};
-	r[0xbb]={0xbb, "add ", "adda", "ex", 1, 0, 3,  4, [this]{ extend  (); R=A+OP; A8(A,OP,R); A=R; }};
-	r[0xcb]={0xcb, "add ", "addb", "im", 0, 0, 2,  2, [this]{ immed2  (); R=B+OP; A8(B,OP,R); B=R; }};
-	r[0xdb]={0xdb, "add ", "addb", "di", 1, 0, 2,  3, [this]{ direct2 (); R=B+OP; A8(B,OP,R); B=R; }};
-	r[0xeb]={0xeb, "add ", "addb", "in", 1, 0, 2,  4, [this]{ index2  (); R=B+OP; A8(B,OP,R); B=R; }};
-	r[0xfb]={0xfb, "add ", "addb", "ex", 1, 0, 3,  4, [this]{ extend  (); R=B+OP; A8(B,OP,R); B=R; }};
-	r[0xc3]={0xc3, "add ", "addd", "im", 0, 0, 3,  3, [this]{ immed3  (); R2=D+OP2; A16(D,OP2,R2); D=R2; }};
-	r[0xd3]={0xd3, "add ", "addd", "di", 1, 0, 2,  4, [this]{ direct16(); R2=D+OP2; A16(D,OP2,R2); D=R2; }};
-	r[0xe3]={0xe3, "add ", "addd", "in", 1, 0, 2,  5, [this]{ index16 (); R2=D+OP2; A16(D,OP2,R2); D=R2; }};
-	r[0xf3]={0xf3, "add ", "addd", "ex", 1, 0, 3,  5, [this]{ extend16(); R2=D+OP2; A16(D,OP2,R2); D=R2; }};
-	r[0x61]={0x61, "and ", "aim ", "in", 0, 1, 3,  7, [this]{ index3  (); M[ADDR]&=OP; L8(M[ADDR]); }};
-	r[0x71]={0x71, "and ", "aim ", "di", 0, 1, 3,  6, [this]{ direct3 (); M[ADDR]&=OP; L8(M[ADDR]); }};
-	r[0x84]={0x84, "and ", "anda", "im", 0, 0, 2,  2, [this]{ immed2  (); A&=OP; L8(A); }};
-	r[0x94]={0x94, "and ", "anda", "di", 1, 0, 2,  3, [this]{ direct2 (); A&=OP; L8(A); }};
-	r[0xa4]={0xa4, "and ", "anda", "in", 1, 0, 2,  4, [this]{ index2  (); A&=OP; L8(A); }};
-	r[0xb4]={0xb4, "and ", "anda", "ex", 1, 0, 3,  4, [this]{ extend  (); A&=OP; L8(A); }};
-	r[0xc4]={0xc4, "and ", "andb", "im", 0, 0, 2,  2, [this]{ immed2  (); B&=OP; L8(B); }};
-	r[0xd4]={0xd4, "and ", "andb", "di", 1, 0, 2,  3, [this]{ direct2 (); B&=OP; L8(B); }};
-	r[0xe4]={0xe4, "and ", "andb", "in", 1, 0, 2,  4, [this]{ index2  (); B&=OP; L8(B); }};
-	r[0xf4]={0xf4, "and ", "andb", "ex", 1, 0, 3,  4, [this]{ extend  (); B&=OP; L8(B); }};
-	r[0x68]={0x68, "asl ", "asl ", "in", 1, 1, 2,  6, [this]{ index2  (); asl(M[ADDR]); }};
-	r[0x78]={0x78, "asl ", "asl ", "ex", 1, 1, 3,  6, [this]{ extend  (); asl(M[ADDR]); }};
-	r[0x48]={0x48, "asl ", "asla", "id", 0, 0, 1,  1, [this]{ implied (); asl(A); }};
-	r[0x58]={0x58, "asl ", "aslb", "id", 0, 0, 1,  1, [this]{ implied (); asl(B); }};
-	r[0x05]={0x05, "asl ", "asld", "id", 0, 0, 1,  1, [this]{ implied (); asld(D); }};
-	r[0x67]={0x67, "asr ", "asr ", "in", 1, 1, 2,  6, [this]{ index2  (); asr(M[ADDR]); }};
-	r[0x77]={0x77, "asr ", "asr ", "ex", 1, 1, 3,  6, [this]{ extend  (); asr(M[ADDR]); }};
-	r[0x47]={0x47, "asr ", "asra", "id", 0, 0, 1,  1, [this]{ implied (); asr(A); }};
-	r[0x57]={0x57, "asr ", "asrb", "id", 0, 0, 1,  1, [this]{ implied (); asr(B); }};
-	r[0x85]={0x85, "bit ", "bita", "im", 0, 0, 2,  2, [this]{ immed2  (); L8(A&OP); }};
-	r[0x95]={0x95, "bit ", "bita", "di", 1, 0, 2,  3, [this]{ direct2 (); L8(A&OP); }};
-	r[0xa5]={0xa5, "bit ", "bita", "in", 1, 0, 2,  4, [this]{ index2  (); L8(A&OP); }};
-	r[0xb5]={0xb5, "bit ", "bita", "ex", 1, 0, 3,  4, [this]{ extend  (); L8(A&OP); }};
-	r[0xc5]={0xc5, "bit ", "bitb", "im", 0, 0, 2,  2, [this]{ immed2  (); L8(B&OP); }};
-	r[0xd5]={0xd5, "bit ", "bitb", "di", 1, 0, 2,  3, [this]{ direct2 (); L8(B&OP); }};
-	r[0xe5]={0xe5, "bit ", "bitb", "in", 1, 0, 2,  4, [this]{ index2  (); L8(B&OP); }};
-	r[0xf5]={0xf5, "bit ", "bitb", "ex", 1, 0, 3,  4, [this]{ extend  (); L8(B&OP); }};
-	r[0x24]={0x24, "bra ", "bcc ", "im", 0, 0, 2,  3, [this]{ immed2  (); bra(!C); }};
-	r[0x25]={0x25, "bra ", "bcs ", "im", 0, 0, 2,  3, [this]{ immed2  (); bra(C); }};
-	r[0x27]={0x27, "bra ", "beq ", "im", 0, 0, 2,  3, [this]{ immed2  (); bra(Z); }};
-	r[0x2c]={0x2c, "bra ", "bge ", "im", 0, 0, 2,  3, [this]{ immed2  (); bra(N^(V==0)); }};
-	r[0x2e]={0x2e, "bra ", "bgt ", "im", 0, 0, 2,  3, [this]{ immed2  (); bra(!(Z|(N^V))); }};
-	r[0x22]={0x22, "bra ", "bhi ", "im", 0, 0, 2,  3, [this]{ immed2  (); bra(!(C|Z)); }};
-	r[0x2f]={0x2f, "bra ", "ble ", "im", 0, 0, 2,  3, [this]{ immed2  (); bra(Z|(N^V)); }};
-	r[0x23]={0x23, "bra ", "bls ", "im", 0, 0, 2,  3, [this]{ immed2  (); bra(C|Z); }};
-	r[0x2d]={0x2d, "bra ", "blt ", "im", 0, 0, 2,  3, [this]{ immed2  (); bra(N^V); }};
-	r[0x2b]={0x2b, "bra ", "bmi ", "im", 0, 0, 2,  3, [this]{ immed2  (); bra(N); }};
-	r[0x26]={0x26, "bra ", "bne ", "im", 0, 0, 2,  3, [this]{ immed2  (); bra(!Z); }};
-	r[0x2a]={0x2a, "bra ", "bpl ", "im", 0, 0, 2,  3, [this]{ immed2  (); bra(!N); }};
-	r[0x20]={0x20, "bra ", "bra ", "im", 0, 0, 2,  3, [this]{ immed2  (); bra(1); }};
-	r[0x21]={0x21, "bra ", "brn ", "im", 0, 0, 2,  3, [this]{ immed2  (); bra(0); }};
-	r[0x28]={0x28, "bra ", "bvc ", "im", 0, 0, 2,  3, [this]{ immed2  (); bra(!V); }};
-	r[0x29]={0x29, "bra ", "bvs ", "im", 0, 0, 2,  3, [this]{ immed2  (); bra(V); }};
-	r[0x8d]={0x8d, "bsr ", "bsr ", "im", 0, 0, 2,  5, [this]{ immed2  (); bsr(); }};
-	r[0x0c]={0x0c, "clr ", "clc ", "id", 0, 0, 1,  1, [this]{ implied (); C=0; }};
-	r[0x0e]={0x0e, "clr ", "cli ", "id", 0, 0, 1,  1, [this]{ implied (); I=0; }};
-	r[0x6f]={0x6f, "clr ", "clr ", "in", 1, 1, 2,  5, [this]{ index2  (); M[ADDR]=0; N=V=C=0; Z=1; }};
-	r[0x7f]={0x7f, "clr ", "clr ", "ex", 1, 1, 3,  5, [this]{ extend  (); M[ADDR]=0; N=V=C=0; Z=1; }};
-	r[0x4f]={0x4f, "clr ", "clra", "id", 0, 0, 1,  1, [this]{ implied (); A=0; N=V=C=0; Z=1; }};
-	r[0x5f]={0x5f, "clr ", "clrb", "id", 0, 0, 1,  1, [this]{ implied (); B=0; N=V=C=0; Z=1; }};
-	r[0x0a]={0x0a, "clr ", "clv ", "id", 0, 0, 1,  1, [this]{ implied (); V=0; }};
-	r[0x11]={0x11, "cmp ", "cba ", "id", 0, 0, 1,  1, [this]{ implied (); R=A-B; S8(A,B,R); }};
-	r[0x81]={0x81, "cmp ", "cmpa", "im", 0, 0, 2,  2, [this]{ immed2  (); R=A-OP; S8(A,OP,R); }};
-	r[0x91]={0x91, "cmp ", "cmpa", "di", 1, 0, 2,  3, [this]{ direct2 (); R=A-OP; S8(A,OP,R); }};
-	r[0xa1]={0xa1, "cmp ", "cmpa", "in", 1, 0, 2,  4, [this]{ index2  (); R=A-OP; S8(A,OP,R); }};
-	r[0xb1]={0xb1, "cmp ", "cmpa", "ex", 1, 0, 3,  4, [this]{ extend  (); R=A-OP; S8(A,OP,R); }};
-	r[0xc1]={0xc1, "cmp ", "cmpb", "im", 0, 0, 2,  2, [this]{ immed2  (); R=B-OP; S8(B,OP,R); }};
-	r[0xd1]={0xd1, "cmp ", "cmpb", "di", 1, 0, 2,  3, [this]{ direct2 (); R=B-OP; S8(B,OP,R); }};
-	r[0xe1]={0xe1, "cmp ", "cmpb", "in", 1, 0, 2,  4, [this]{ index2  (); R=B-OP; S8(B,OP,R); }};
-	r[0xf1]={0xf1, "cmp ", "cmpb", "ex", 1, 0, 3,  4, [this]{ extend  (); R=B-OP; S8(B,OP,R); }};
-	r[0x8c]={0x8c, "cmp ", "cpx ", "im", 0, 0, 3,  3, [this]{ immed3  (); R2=IX-OP2; S16(IX,OP2,R2); }};
-	r[0x9c]={0x9c, "cmp ", "cpx ", "di", 1, 0, 2,  4, [this]{ direct16(); R2=IX-OP2; S16(IX,OP2,R2); }};
-	r[0xac]={0xac, "cmp ", "cpx ", "in", 1, 0, 2,  5, [this]{ index16 (); R2=IX-OP2; S16(IX,OP2,R2); }};
-	r[0xbc]={0xbc, "cmp ", "cpx ", "ex", 1, 0, 3,  5, [this]{ extend16(); R2=IX-OP2; S16(IX,OP2,R2); }};
-	r[0x63]={0x63, "com ", "com ", "in", 1, 1, 2,  6, [this]{ index2  (); M[ADDR]=~OP; C=1; L8(M[ADDR]); }};
-	r[0x73]={0x73, "com ", "com ", "ex", 1, 1, 3,  6, [this]{ extend  (); M[ADDR]=~OP; C=1; L8(M[ADDR]); }};
-	r[0x43]={0x43, "com ", "coma", "id", 0, 0, 1,  1, [this]{ implied (); A=~A; C=1; L8(A); }};
-	r[0x53]={0x53, "com ", "comb", "id", 0, 0, 1,  1, [this]{ implied (); B=~B; C=1; L8(B); }};
-	r[0x19]={0x19, "daa ", "daa ", "id", 0, 0, 1,  2, [this]{ implied (); daa(); }};
-	r[0x6a]={0x6a, "dec ", "dec ", "in", 1, 1, 2,  6, [this]{ index2  (); M[ADDR]--; D8(M[ADDR]); }};
-	r[0x7a]={0x7a, "dec ", "dec ", "ex", 1, 1, 3,  6, [this]{ extend  (); M[ADDR]--; D8(M[ADDR]); }};
-	r[0x4a]={0x4a, "dec ", "deca", "id", 0, 0, 1,  1, [this]{ implied (); A--; D8(A); }};
-	r[0x5a]={0x5a, "dec ", "decb", "id", 0, 0, 1,  1, [this]{ implied (); B--; D8(B); }};
-	r[0x34]={0x34, "dec ", "des ", "id", 0, 0, 1,  1, [this]{ implied (); SP--; }};
-	r[0x09]={0x09, "dec ", "dex ", "id", 0, 0, 1,  1, [this]{ implied (); IX--; Z=!IX; }};
-	r[0x65]={0x65, "eor ", "eim ", "in", 0, 1, 3,  7, [this]{ index3  (); M[ADDR]^=OP; L8(M[ADDR]); }};
-	r[0x75]={0x75, "eor ", "eim ", "di", 0, 1, 3,  6, [this]{ direct3 (); M[ADDR]^=OP; L8(M[ADDR]); }};
-	r[0x88]={0x88, "eor ", "eora", "im", 0, 0, 2,  2, [this]{ immed2  (); A^=OP; L8(A); }};
-	r[0x98]={0x98, "eor ", "eora", "di", 1, 0, 2,  3, [this]{ direct2 (); A^=OP; L8(A); }};
-	r[0xa8]={0xa8, "eor ", "eora", "in", 1, 0, 2,  4, [this]{ index2  (); A^=OP; L8(A); }};
-	r[0xb8]={0xb8, "eor ", "eora", "ex", 1, 0, 3,  4, [this]{ extend  (); A^=OP; L8(A); }};
-	r[0xc8]={0xc8, "eor ", "eorb", "im", 0, 0, 2,  2, [this]{ immed2  (); B^=OP; L8(B); }};
-	r[0xd8]={0xd8, "eor ", "eorb", "di", 1, 0, 2,  3, [this]{ direct2 (); B^=OP; L8(B); }};
-	r[0xe8]={0xe8, "eor ", "eorb", "in", 1, 0, 2,  4, [this]{ index2  (); B^=OP; L8(B); }};
-	r[0xf8]={0xf8, "eor ", "eorb", "ex", 1, 0, 3,  4, [this]{ extend  (); B^=OP; L8(B); }};
-	r[0x18]={0x18, "exg ", "xgdx", "id", 0, 0, 1,  2, [this]{ implied (); OP2=IX; IX=D; D=OP2; }};
-	r[0x6c]={0x6c, "inc ", "inc ", "in", 1, 1, 2,  6, [this]{ index2  (); M[ADDR]++; I8(M[ADDR]); }};
-	r[0x7c]={0x7c, "inc ", "inc ", "ex", 1, 1, 3,  6, [this]{ extend  (); M[ADDR]++; I8(M[ADDR]); }};
-	r[0x4c]={0x4c, "inc ", "inca", "id", 0, 0, 1,  1, [this]{ implied (); A++; I8(A); }};
-	r[0x5c]={0x5c, "inc ", "incb", "id", 0, 0, 1,  1, [this]{ implied (); B++; I8(B); }};
-	r[0x31]={0x31, "inc ", "ins ", "id", 0, 0, 1,  1, [this]{ implied (); SP++               ;}};
-	r[0x08]={0x08, "inc ", "inx ", "id", 0, 0, 1,  1, [this]{ implied (); IX++; Z=!IX; }};
-	r[0x6e]={0x6e, "jmp ", "jmp ", "in", 1, 0, 2,  3, [this]{ index2  (); PC=ADDR; }};
-	r[0x7e]={0x7e, "jmp ", "jmp ", "ex", 1, 0, 3,  3, [this]{ extend  (); PC=ADDR; }};
-	r[0x9d]={0x9d, "jsr ", "jsr ", "di", 1, 1, 2,  5, [this]{ direct2 (); push(PC); PC=ADDR; }};
-	r[0xad]={0xad, "jsr ", "jsr ", "in", 1, 1, 2,  5, [this]{ index2  (); push(PC); PC=ADDR; }};
-	r[0xbd]={0xbd, "jsr ", "jsr ", "ex", 1, 1, 3,  6, [this]{ extend  (); push(PC); PC=ADDR; }};
-	r[0x86]={0x86, "ld  ", "ldaa", "im", 0, 0, 2,  2, [this]{ immed2  (); A=OP; L8(A); }};
-	r[0x96]={0x96, "ld  ", "ldaa", "di", 1, 0, 2,  3, [this]{ direct2 (); A=OP; L8(A); }};
-	r[0xa6]={0xa6, "ld  ", "ldaa", "in", 1, 0, 2,  4, [this]{ index2  (); A=OP; L8(A); }};
-	r[0xb6]={0xb6, "ld  ", "ldaa", "ex", 1, 0, 3,  4, [this]{ extend  (); A=OP; L8(A); }};
-	r[0xc6]={0xc6, "ld  ", "ldab", "im", 0, 0, 2,  2, [this]{ immed2  (); B=OP; L8(B); }};
-	r[0xd6]={0xd6, "ld  ", "ldab", "di", 1, 0, 2,  3, [this]{ direct2 (); B=OP; L8(B); }};
-	r[0xe6]={0xe6, "ld  ", "ldab", "in", 1, 0, 2,  4, [this]{ index2  (); B=OP; L8(B); }};
-	r[0xf6]={0xf6, "ld  ", "ldab", "ex", 1, 0, 3,  4, [this]{ extend  (); B=OP; L8(B); }};
-	r[0xcc]={0xcc, "ld  ", "ldd ", "im", 0, 0, 3,  3, [this]{ immed3  (); D=OP2; L16(D); }};
-	r[0xdc]={0xdc, "ld  ", "ldd ", "di", 1, 0, 2,  4, [this]{ direct2 (); D=getm16(ADDR); L16(D); }};
-	r[0xec]={0xec, "ld  ", "ldd ", "in", 1, 0, 2,  5, [this]{ index2  (); D=getm16(ADDR); L16(D); }};
-	r[0xfc]={0xfc, "ld  ", "ldd ", "ex", 1, 0, 3,  5, [this]{ extend  (); D=getm16(ADDR); L16(D); }};
-	r[0x8e]={0x8e, "ld  ", "lds ", "im", 0, 0, 3,  3, [this]{ immed3  (); SP=OP2; L16(SP); }};
-	r[0x9e]={0x9e, "ld  ", "lds ", "di", 1, 0, 2,  4, [this]{ direct2 (); SP=getm16(ADDR); L16(SP); }};
-	r[0xae]={0xae, "ld  ", "lds ", "in", 1, 0, 2,  5, [this]{ index2  (); SP=getm16(ADDR); L16(SP); }};
-	r[0xbe]={0xbe, "ld  ", "lds ", "ex", 1, 0, 3,  5, [this]{ extend  (); SP=getm16(ADDR); L16(SP); }};
-	r[0xce]={0xce, "ld  ", "ldx ", "im", 0, 0, 3,  3, [this]{ immed3  (); IX=OP2; L16(IX); }};
-	r[0xde]={0xde, "ld  ", "ldx ", "di", 1, 0, 2,  4, [this]{ direct2 (); IX=getm16(ADDR); L16(IX); }};
-	r[0xee]={0xee, "ld  ", "ldx ", "in", 1, 0, 2,  5, [this]{ index2  (); IX=getm16(ADDR); L16(IX); }};
-	r[0xfe]={0xfe, "ld  ", "ldx ", "ex", 1, 0, 3,  5, [this]{ extend  (); IX=getm16(ADDR); L16(IX); }};
-	r[0x64]={0x64, "lsr ", "lsr ", "in", 1, 1, 2,  6, [this]{ index2  (); lsr(M[ADDR]); }};
-	r[0x74]={0x74, "lsr ", "lsr ", "ex", 1, 1, 3,  6, [this]{ extend  (); lsr(M[ADDR]); }};
-	r[0x44]={0x44, "lsr ", "lsra", "id", 0, 0, 1,  1, [this]{ implied (); lsr(A); }};
-	r[0x54]={0x54, "lsr ", "lsrb", "id", 0, 0, 1,  1, [this]{ implied (); lsr(B); }};
-	r[0x04]={0x04, "lsr ", "lsrd", "id", 0, 0, 1,  1, [this]{ implied (); lsrd(D); }};
-	r[0x3d]={0x3d, "mul ", "mul ", "id", 0, 0, 1,  7, [this]{ implied (); D=A*B; C=bit(D,7); }};
-	r[0x60]={0x60, "neg ", "neg ", "in", 1, 1, 2,  6, [this]{ index2  (); M[ADDR]=-OP; I8(M[ADDR]); C=!Z; }};
-	r[0x70]={0x70, "neg ", "neg ", "ex", 1, 1, 3,  6, [this]{ extend  (); M[ADDR]=-OP; I8(M[ADDR]); C=!Z; }};
-	r[0x40]={0x40, "neg ", "nega", "id", 0, 1, 1,  1, [this]{ implied (); A=-A; I8(A); C=!Z; }};
-	r[0x50]={0x50, "neg ", "negb", "id", 0, 1, 1,  1, [this]{ implied (); B=-B; I8(B); C=!Z; }};
-	r[0x01]={0x01, "nop ", "nop ", "id", 0, 0, 1,  1, [this]{ implied (); }};
-	r[0x62]={0x62, "or  ", "oim ", "in", 0, 1, 3,  7, [this]{ index3  (); M[ADDR]|=OP; V=0; L8(M[ADDR]); }};
-	r[0x72]={0x72, "or  ", "oim ", "di", 0, 1, 3,  6, [this]{ direct3 (); M[ADDR]|=OP; V=0; L8(M[ADDR]); }};
-	r[0x8a]={0x8a, "or  ", "oraa", "im", 0, 0, 2,  2, [this]{ immed2  (); A|=OP; V=0; L8(A); }};
-	r[0x9a]={0x9a, "or  ", "oraa", "di", 1, 0, 2,  3, [this]{ direct2 (); A|=OP; V=0; L8(A); }};
-	r[0xaa]={0xaa, "or  ", "oraa", "in", 1, 0, 2,  4, [this]{ index2  (); A|=OP; V=0; L8(A); }};
-	r[0xba]={0xba, "or  ", "oraa", "ex", 1, 0, 3,  4, [this]{ extend  (); A|=OP; V=0; L8(A); }};
-	r[0xca]={0xca, "or  ", "orab", "im", 0, 0, 2,  2, [this]{ immed2  (); B|=OP; V=0; L8(B); }};
-	r[0xda]={0xda, "or  ", "orab", "di", 1, 0, 2,  3, [this]{ direct2 (); B|=OP; V=0; L8(B); }};
-	r[0xea]={0xea, "or  ", "orab", "in", 1, 0, 2,  4, [this]{ index2  (); B|=OP; V=0; L8(B); }};
-	r[0xfa]={0xfa, "or  ", "orab", "ex", 1, 0, 3,  4, [this]{ extend  (); B|=OP; V=0; L8(B); }};
-	r[0x32]={0x32, "pull", "pula", "id", 0, 0, 1,  3, [this]{ implied (); A=M[++SP]; }};
-	r[0x33]={0x33, "pull", "pulb", "id", 0, 0, 1,  3, [this]{ implied (); B=M[++SP]; }};
-	r[0x38]={0x38, "pull", "pulx", "id", 0, 0, 1,  4, [this]{ implied (); pull(IX); }};
-	r[0x36]={0x36, "push", "psha", "id", 0, 1, 1,  4, [this]{ implied (); M[SP--]=A; }};
-	r[0x37]={0x37, "push", "pshb", "id", 0, 1, 1,  4, [this]{ implied (); M[SP--]=B; }};
-	r[0x3c]={0x3c, "push", "pshx", "id", 0, 1, 1,  5, [this]{ implied (); push(IX); }};
-	r[0x69]={0x69, "rol ", "rol ", "in", 1, 1, 2,  6, [this]{ index2  (); rol(M[ADDR]); }};
-	r[0x79]={0x79, "rol ", "rol ", "ex", 1, 1, 3,  6, [this]{ extend  (); rol(M[ADDR]); }};
-	r[0x49]={0x49, "rol ", "rola", "id", 0, 0, 1,  1, [this]{ implied (); rol(A); }};
-	r[0x59]={0x59, "rol ", "rolb", "id", 0, 0, 1,  1, [this]{ implied (); rol(B); }};
-	r[0x66]={0x66, "ror ", "ror ", "in", 1, 1, 2,  6, [this]{ index2  (); ror(M[ADDR]); }};
-	r[0x76]={0x76, "ror ", "ror ", "ex", 1, 1, 3,  6, [this]{ extend  (); ror(M[ADDR]); }};
-	r[0x46]={0x46, "ror ", "rora", "id", 0, 0, 1,  1, [this]{ implied (); ror(A); }};
-	r[0x56]={0x56, "ror ", "rorb", "id", 0, 0, 1,  1, [this]{ implied (); ror(B); }};
-	r[0x3b]={0x3b, "rts ", "rti ", "id", 0, 0, 1, 10, [this]{ implied (); rti(); }};
-	r[0x39]={0x39, "rts ", "rts ", "id", 0, 0, 1,  5, [this]{ implied (); pull(PC); }};
-	r[0x82]={0x82, "sbc ", "sbca", "im", 0, 0, 2,  2, [this]{ immed2  (); R=A-OP-C; S8(A,OP,R); A=R; }};
-	r[0x92]={0x92, "sbc ", "sbca", "di", 1, 0, 2,  3, [this]{ direct2 (); R=A-OP-C; S8(A,OP,R); A=R; }};
-	r[0xa2]={0xa2, "sbc ", "sbca", "in", 1, 0, 2,  4, [this]{ index2  (); R=A-OP-C; S8(A,OP,R); A=R; }};
-	r[0xb2]={0xb2, "sbc ", "sbca", "ex", 1, 0, 3,  4, [this]{ extend  (); R=A-OP-C; S8(A,OP,R); A=R; }};
-	r[0xc2]={0xc2, "sbc ", "sbcb", "im", 0, 0, 2,  2, [this]{ immed2  (); R=B-OP-C; S8(B,OP,R); B=R; }};
-	r[0xd2]={0xd2, "sbc ", "sbcb", "di", 1, 0, 2,  3, [this]{ direct2 (); R=B-OP-C; S8(B,OP,R); B=R; }};
-	r[0xe2]={0xe2, "sbc ", "sbcb", "in", 1, 0, 2,  4, [this]{ index2  (); R=B-OP-C; S8(B,OP,R); B=R; }};
-	r[0xf2]={0xf2, "sbc ", "sbcb", "ex", 1, 0, 3,  4, [this]{ extend  (); R=B-OP-C; S8(B,OP,R); B=R; }};
-	r[0x0d]={0x0d, "set ", "sec ", "id", 0, 0, 1,  1, [this]{ implied (); C=1; }};
-	r[0x0f]={0x0f, "set ", "sei ", "id", 0, 0, 1,  1, [this]{ implied (); I=1; }};
-	r[0x0b]={0x0b, "set ", "sev ", "id", 0, 0, 1,  1, [this]{ implied (); V=1; }};
-	r[0x97]={0x97, "st  ", "staa", "di", 1, 1, 2,  3, [this]{ direct2 (); M[ADDR]=A; V=0; L8(M[ADDR]); }};
-	r[0xa7]={0xa7, "st  ", "staa", "in", 1, 1, 2,  4, [this]{ index2  (); M[ADDR]=A; V=0; L8(M[ADDR]); }};
-	r[0xb7]={0xb7, "st  ", "staa", "ex", 1, 1, 3,  4, [this]{ extend  (); M[ADDR]=A; V=0; L8(M[ADDR]); }};
-	r[0xd7]={0xd7, "st  ", "stab", "di", 1, 1, 2,  3, [this]{ direct2 (); M[ADDR]=B; V=0; L8(M[ADDR]); }};
-	r[0xe7]={0xe7, "st  ", "stab", "in", 1, 1, 2,  4, [this]{ index2  (); M[ADDR]=B; V=0; L8(M[ADDR]); }};
-	r[0xf7]={0xf7, "st  ", "stab", "ex", 1, 1, 3,  4, [this]{ extend  (); M[ADDR]=B; V=0; L8(M[ADDR]); }};
-	r[0xdd]={0xdd, "st  ", "std ", "di", 1, 1, 2,  4, [this]{ direct2 (); stom16(ADDR,D); L16(D); }};
-	r[0xed]={0xed, "st  ", "std ", "in", 1, 1, 2,  5, [this]{ index2  (); stom16(ADDR,D); L16(D); }};
-	r[0xfd]={0xfd, "st  ", "std ", "ex", 1, 1, 3,  5, [this]{ extend  (); stom16(ADDR,D); L16(D); }};
-	r[0x9f]={0x9f, "st  ", "sts ", "di", 1, 1, 2,  4, [this]{ direct2 (); stom16(ADDR,SP); L16(SP); }};
-	r[0xaf]={0xaf, "st  ", "sts ", "in", 1, 1, 2,  5, [this]{ index2  (); stom16(ADDR,SP); L16(SP); }};
-	r[0xbf]={0xbf, "st  ", "sts ", "ex", 1, 1, 3,  5, [this]{ extend  (); stom16(ADDR,SP); L16(SP); }};
-	r[0xdf]={0xdf, "st  ", "stx ", "di", 1, 1, 2,  4, [this]{ direct2 (); stom16(ADDR,IX); L16(IX); }};
-	r[0xef]={0xef, "st  ", "stx ", "in", 1, 1, 2,  5, [this]{ index2  (); stom16(ADDR,IX); L16(IX); }};
-	r[0xff]={0xff, "st  ", "stx ", "ex", 1, 1, 3,  5, [this]{ extend  (); stom16(ADDR,IX); L16(IX); }};
-	r[0x10]={0x10, "sub ", "sba ", "id", 0, 0, 1,  1, [this]{ implied (); R=A-B; S8(A,B,R); A=R; }};
-	r[0x80]={0x80, "sub ", "suba", "im", 0, 0, 2,  2, [this]{ immed2  (); R=A-OP; S8(A,OP,R); A=R; }};
-	r[0x90]={0x90, "sub ", "suba", "di", 1, 0, 2,  3, [this]{ direct2 (); R=A-OP; S8(A,OP,R); A=R; }};
-	r[0xa0]={0xa0, "sub ", "suba", "in", 1, 0, 2,  4, [this]{ index2  (); R=A-OP; S8(A,OP,R); A=R; }};
-	r[0xb0]={0xb0, "sub ", "suba", "ex", 1, 0, 3,  4, [this]{ extend  (); R=A-OP; S8(A,OP,R); A=R; }};
-	r[0xc0]={0xc0, "sub ", "subb", "im", 0, 0, 2,  2, [this]{ immed2  (); R=B-OP; S8(B,OP,R); B=R; }};
-	r[0xd0]={0xd0, "sub ", "subb", "di", 1, 0, 2,  3, [this]{ direct2 (); R=B-OP; S8(B,OP,R); B=R; }};
-	r[0xe0]={0xe0, "sub ", "subb", "in", 1, 0, 2,  4, [this]{ index2  (); R=B-OP; S8(B,OP,R); B=R; }};
-	r[0xf0]={0xf0, "sub ", "subb", "ex", 1, 0, 3,  4, [this]{ extend  (); R=B-OP; S8(B,OP,R); B=R; }};
-	r[0x83]={0x83, "sub ", "subd", "im", 0, 0, 3,  3, [this]{ immed3  (); R2=D-OP2; S16(D,OP2,R2); D=R2; }};
-	r[0x93]={0x93, "sub ", "subd", "di", 1, 0, 2,  4, [this]{ direct16(); R2=D-OP2; S16(D,OP2,R2); D=R2; }};
-	r[0xa3]={0xa3, "sub ", "subd", "in", 1, 0, 2,  5, [this]{ index16 (); R2=D-OP2; S16(D,OP2,R2); D=R2; }};
-	r[0xb3]={0xb3, "sub ", "subd", "ex", 1, 0, 3,  5, [this]{ extend16(); R2=D-OP2; S16(D,OP2,R2); D=R2; }};
-	r[0x3f]={0x3f, "swi ", "swi ", "id", 0, 0, 1, 12, [this]{ implied (); swi(); }};
-	r[0x16]={0x16, "tfr ", "tab ", "id", 0, 0, 1,  1, [this]{ implied (); B=A; V=0; L8(B); }};
-	r[0x06]={0x06, "tfr ", "tap ", "id", 0, 0, 1,  1, [this]{ implied (); setCCR(A); }};
-	r[0x17]={0x17, "tfr ", "tba ", "id", 0, 0, 1,  1, [this]{ implied (); A=B; V=0; L8(A); }};
-	r[0x07]={0x07, "tfr ", "tpa ", "id", 0, 0, 1,  1, [this]{ implied (); A=getCCR(); }};
-	r[0x30]={0x30, "tfr ", "tsx ", "id", 0, 0, 1,  1, [this]{ implied (); IX=SP+1; }};
-	r[0x35]={0x35, "tfr ", "txs ", "id", 0, 0, 1,  1, [this]{ implied (); SP=IX-1; }};
-	r[0x6b]={0x6b, "tst ", "tim ", "in", 1, 0, 3,  5, [this]{ index3  (); V=0; L8(M[ADDR]&OP); }};
-	r[0x7b]={0x7b, "tst ", "tim ", "di", 1, 0, 3,  4, [this]{ direct3 (); V=0; L8(M[ADDR]&OP); }};
-	r[0x6d]={0x6d, "tst ", "tst ", "in", 1, 0, 2,  4, [this]{ index2  (); V=0; L8(OP); }};
-	r[0x7d]={0x7d, "tst ", "tst ", "ex", 1, 0, 3,  4, [this]{ extend  (); V=0; L8(OP); }};
-	r[0x4d]={0x4d, "tst ", "tsta", "id", 0, 0, 1,  1, [this]{ implied (); V=0; L8(A); }};
-	r[0x5d]={0x5d, "tst ", "tstb", "id", 0, 0, 1,  1, [this]{ implied (); V=0; L8(B); }};
-	r[0x1a]={0x1a, "wait", "slp ", "id", 0, 0, 1,  4, [this]{ implied (); isleep(); }};
-	r[0x3e]={0x3e, "wait", "wai ", "id", 0, 0, 1,  9, [this]{ implied (); wait(); }};
-}
+#include <cstring>
+#include <algorithm>
+#include "HD6303R_ops.h"
 
-// CCR utilities /////////////////////////////
-void HD6303R::A8(uint8_t op1, uint8_t op2, uint8_t r) { // additive arithmetic 8 bit
-	uint8_t c = (op1 & op2) | (op2 & ~r) | (~r & op1);
-	H = c & (1<<3);
-	N = r & (1<<7);
-	Z = !r;
-	V = ( (op1 & op2 & ~r) | (~op1 & ~op2 & r ) ) & (1<<7);
-	C = c & (1<<7);
-}
-void HD6303R::A16(uint16_t op1, uint16_t op2, uint16_t r) { // additive arithmetic 16 bit
-	N = r & (1<<15);
-	Z = !r;
-	V = ( (op1 & op2 & ~r) | (~op1 & ~op2 & r) ) & (1<<15);
-	C = ( (op1 & op2) | (op2 & ~r) | (~r & op1) ) & (1<<15);
-}
-void HD6303R::S8(uint8_t op1, uint8_t op2, uint8_t r) { // subtractive arithmetic 8 bit
-	N = r & (1<<7);
-	Z = !r;
-	V = ( (op1 & ~op2 & ~r) | (~op1 & op2 & r) ) & (1<<7);
-	C = ( (~op1 & op2) | (op2 & r) | (r & ~op1) ) & (1<<7);
-}
-void HD6303R::S16(uint16_t op1, uint16_t op2, uint16_t r) { // subtractive arithmetic 16 bit
-	N = r & (1<<15);
-	Z = !r;
-	V = ( (op1 & ~op2 & ~r) | (~op1 & op2 & r) ) & (1<<15);
-	C = ( (~op1 & op2) | (op2 & r) | (r & ~op1) ) & (1<<15);
-}
-void HD6303R::L8(uint8_t r) { // logical operations 8 bit
-	N = r & (1<<7);
-	Z = !r;
-	V = 0;
-}
-void HD6303R::L16(uint16_t r) { // logical operations 16 bit
-	N = r & (1<<15);
-	Z = !r;
-	V = 0;
-}
-void HD6303R::D8(uint8_t r) { // decrement 8 bit
-	N = r & (1<<7);
-	Z = !r;
-	V = (r==0x7F);
-}
-void HD6303R::I8(uint8_t r) { // increment 8 bit
-	N = r & (1<<7);
-	Z = !r;
-	V = (r==0x80);
+// Metadata and execution tables, generated from HD6303R_inst.h
+static constexpr std::array<HD6303R::Instruction, 256> buildInstructions() {
+	std::array<HD6303R::Instruction, 256> t{};
+#define OPCODE(op, grp, inst, am, r, w, bytes, cycles, ...) \
+	t[op] = HD6303R::Instruction{op, grp, inst, am, r, w, bytes, cycles};
+#include "HD6303R_inst.h"
+#undef OPCODE
+	return t;
 }
 
-// Instruction helpers
-void HD6303R::isleep() { halt = true; }
-void HD6303R::wait() {
-	halt = true;
-	push(PC);
-	push(IX);
-	memory[SP--] = A;
-	memory[SP--] = B;
-	memory[SP--] = getCCR();
+static constexpr std::array<HD6303R::InstInfo, 256> buildInstInfo() {
+	std::array<HD6303R::InstInfo, 256> t{};
+#define OPCODE(op, grp, inst, am, r, w, bytes, cycles, ...) \
+	t[op] = HD6303R::InstInfo{cycles, r, w, true};
+#include "HD6303R_inst.h"
+#undef OPCODE
+	return t;
 }
 
-void HD6303R::bra(bool c) { if(c) PC += extend8(OP); }
-void HD6303R::bsr() { push(PC); PC += extend8(OP); }
+constexpr std::array<HD6303R::Instruction, 256> HD6303R::instructions = buildInstructions();
+constexpr std::array<HD6303R::InstInfo, 256> HD6303R::instInfo = buildInstInfo();
 
-void HD6303R::asl(uint8_t &x) { // 8 bit
-	C = bit(x,7);
-	x <<= 1;
-	N = bit(x,7);
-	Z = !x;
-	V = N^C;
-}
+// Instruction dispatch ///////////////////////
 
-void HD6303R::asld(uint16_t &x) { // 16 bit
-	C = bit(x,15);
-	x <<= 1;
-	N = bit(x,15);
-	Z = !x;
-	V = N^C;
-}
+// The instruction bodies are expanded in line from HD6303R_inst.h, so the
+// helpers in HD6303R_ops.h are inlined into each case. By default a switch
+// is used, which GCC compiles to a bounds-checked jump table. With
+// COMPUTED_GOTO (GCC labels-as-values) the opcode jumps directly through a
+// table of label addresses instead. Since step() does the timer and SCI
+// work between instructions, both end up close in speed - try each on the
+// target machine.
+void HD6303R::execute() {
+#if defined(COMPUTED_GOTO) && defined(__GNUC__)
+	static void* const* const dispatch = ({
+		static void* table[256];
+		for(auto& t : table) t = &&illegal;
+#define OPCODE(op, ...) table[op] = &&op_##op;
+#include "HD6303R_inst.h"
+#undef OPCODE
+		table;
+	});
 
-void HD6303R::asr(uint8_t &x) { // 8 bit
-	C = bit(x,0);
-	x = int8_t(x)>>1;
-	N = bit(x,7);
-	Z = !x;
-	V = N^C;
+	goto *dispatch[opcode];
+#define OPCODE(op, grp, inst, am, r, w, bytes, cycles, ...) op_##op: __VA_ARGS__ return;
+#include "HD6303R_inst.h"
+#undef OPCODE
+illegal:
+	return;
+#else
+	switch(opcode) {
+#define OPCODE(op, grp, inst, am, r, w, bytes, cycles, ...) case op: __VA_ARGS__ break;
+#include "HD6303R_inst.h"
+#undef OPCODE
+		default: break; // illegal, trapped in step()
+	}
+#endif
 }
 
-void HD6303R::lsr(uint8_t &x) { // 8 bit
-	C = bit(x,0);
-	x >>= 1;
-	N = 0;
-	Z = !x;
-	V = N^C;
-}
 
-void HD6303R::lsrd(uint16_t &x) { // 16 bit
-	C = bit(x,0);
-	x >>= 1;
-	N = 0;
-	Z = !x;
-	V = N^C;
+// ROM translation cache /////////////////////
+
+// Run a decoded micro-op
+void HD6303R::execute(const UOp& u) {
+	PC += u.bytes;
+	switch(u.opcode) {
+#define OPCODE(op, ...) case op: exec<op>(u.operand); break;
+#include "HD6303R_inst.h"
+#undef OPCODE
+		default: break; // never decoded
+	}
 }
 
-void HD6303R::rol(uint8_t &x) { // rotate left
-	bool c = bit(x,7);
-	x <<= 1;
-	x |= C;
-	C = c;
-	N = 0;
-	Z = !x;
-	V = N^C;
+static bool is(const char *s, const char *t) { return !strcmp(s, t); }
+
+// Ends a basic block
+static bool isBranch(const HD6303R::Instruction& i) {
+	return is(i.group, "bra ") || is(i.group, "bsr ") || is(i.group, "jmp ")
+		|| is(i.group, "jsr ") || is(i.group, "rts ") || is(i.group, "swi ")
+		|| is(i.group, "wait");
 }
 
-void HD6303R::ror(uint8_t &x) { // rotate right
-	bool c = bit(x,0);
-	x >>= 1;
-	x |= (C<<7);
-	C = c;
-	N = 0;
-	Z = !x;
-	V = N^C;
+// Memory address an instruction reads or writes, if fixed by its operand,
+// -1 if it depends on IX, or -2 if there is no memory operand
+static int staticAddress(const HD6303R::Instruction& i, uint16_t operand) {
+	if(is(i.mode, "di")) return i.bytes==3 ? operand&0xFF : operand;
+	if(is(i.mode, "ex")) return operand;
+	if(is(i.mode, "in")) return -1;
+	return -2;
 }
 
-void HD6303R::pull(uint16_t &x) {
-	x = memory[++SP] << 8;
-	x |= memory[++SP];
+// Writes that the host or the CPU itself acts on after the step
+static bool observedWrite(int addr) {
+	return addr < 0x20 // On-chip registers
+		|| (addr&0xFFF0)==0x2800 // Peripherals
+		|| (addr&0xFF00)==0x3000 // EGS
+		|| addr >= HD6303R::ROM; // Translation cache
 }
 
-void HD6303R::rti() {
-	setCCR(memory[++SP]);
-	B = memory[++SP];
-	A = memory[++SP];
-	pull(IX);
-	pull(PC);
+// First of a fused pair: no writes, no control flow, and nothing that
+// changes SP, the I mask, or reads the on-chip registers
+static bool fusesFirst(const HD6303R::Instruction& i, uint16_t operand) {
+	if(i.w || isBranch(i)) return false;
+	if(is(i.op, "cli ") || is(i.op, "sei ") || is(i.op, "tap ")) return false;
+	if(is(i.op, "lds ") || is(i.op, "txs ") || is(i.op, "ins ") || is(i.op, "des ")
+		|| is(i.group, "pull")) return false;
+	int addr = staticAddress(i, operand);
+	return addr == -2 || addr >= 0x20;
 }
 
-void HD6303R::daa() {
-	uint8_t c = 0;
-	uint8_t lsn = (A & 0x0F);
-	uint8_t msn = (A & 0xF0) >> 4;
-	if (H || (lsn > 9)) c |= 0x06;
-	if (C || (msn > 9) || ((msn > 8) && (lsn > 9))) c |= 0x60;
-	uint16_t t = uint16_t(A) + c;
-	C |= bit(t, 8);
-	A = uint8_t(t);
-	N = bit(A, 7);
-	Z = !A;
+// Second of a fused pair: anything but rti/swi/wai/slp, as long as
+// any memory it writes is ordinary RAM, and it doesn't read the on-chip
+// registers (the timer would not yet include the first's cycles).
+// Indexed reads are checked when run.
+static bool fusesSecond(const HD6303R::Instruction& i, uint16_t operand) {
+	if(is(i.op, "rti ") || is(i.group, "swi ") || is(i.group, "wait")) return false;
+	int addr = staticAddress(i, operand);
+	if(addr >= 0 && addr < 0x20) return false;
+	if(!i.w || is(i.mode, "id") || is(i.group, "jsr ")) return true; // Writes only the stack
+	return addr >= 0 && !observedWrite(addr) && !observedWrite(addr+1);
 }
 
+// Decode from pc to the end of its basic block
+void HD6303R::decodeBlock(uint16_t pc) {
+	UOp *prev = 0;
+	for(int a = pc; a < 0x10000; ) {
+		UOp &u = romCache[a-ROM];
+		bool decoded = u.bytes;
+		if(!decoded) {
+			const Instruction &i = instructions[memory[a]];
+			if(!instInfo[i.opcode].legal || a + i.bytes > 0x10000) break; // Left to step()
+			u.opcode = i.opcode;
+			u.info = instInfo[i.opcode];
+			u.bytes = i.bytes;
+			u.indexed = is(i.mode, "in");
+			u.operand = 0;
+			for(int b=1; b<i.bytes; b++) u.operand = u.operand<<8 | memory[a+b];
+			int addr = staticAddress(i, u.operand);
+			u.regs = addr == -1 || (addr >= 0 && addr < 0x20);
+			u.fuse = false;
+		}
+		const Instruction &i = instructions[u.opcode];
+		if(prev) prev->fuse = fusesFirst(instructions[prev->opcode], prev->operand)
+			&& fusesSecond(i, u.operand);
+		if(isBranch(i) || decoded) break; // End of block, or rest already decoded
+		prev = &u;
+		a += u.bytes;
+	}
+}
 
-// Addressing modes /////////////////////////
+#ifndef RECOMPILED
+// Built without the recompiled firmware
+bool HD6303R::nativeROM() { return false; }
+bool HD6303R::stepNative() { return false; }
+#endif
 
-void HD6303R::direct2() {
-	ADDR = memory[PC++];
-	OP = memory[ADDR];
+// ROM [lo,hi] modified: stop using the recompiled firmware and the
+// native routines, and drop decoded micro-ops overlapping the range.
+// A fused pair spans up to 6 bytes, so also those starting just before.
+void HD6303R::invalidate(uint16_t lo, uint16_t hi) {
+	if(hi < ROM) return;
+	native = false;
+	idleLength = 0; // Its code may have changed
+	for(auto &r : routineAt) r = 0;
+	routines.resize(1);
+	for(int a = lo < ROM+5 ? ROM : lo-5; a <= hi; a++) romCache[a-ROM] = UOp();
 }
 
-void HD6303R::direct16() {
-	ADDR = memory[PC++];
-	OP2 = getm16(ADDR);
+// Instruction may have stored into ROM
+void HD6303R::romWrite(uint16_t addr) {
+	const Instruction &i = instructions[opcode];
+	if(is(i.mode, "id") || is(i.group, "jsr ")) return; // Only wrote the stack
+	invalidate(addr, addr==0xFFFF ? addr : addr+1);
 }
 
-void HD6303R::direct3() { // AIM
-	OP = memory[PC++];
-	ADDR = memory[PC++];
+// Run the micro-op u at PC as one step with the next, if nothing could
+// have happened in between. The host has already allowed u's cycles
+// through fuseLimit.
+bool HD6303R::stepFused(const UOp& u) {
+	const UOp &u2 = romCache[PC+u.bytes-ROM];
+	int c = u.info.cycles + u2.info.cycles;
+	if(!u2.bytes) return false;
+	// No pending interrupt, OCR match or timer wrap (see schedule())
+	if(cycle + c >= nextEvent) return false;
+
+	execute(u);
+	if(u2.indexed && uint16_t(IX + (u2.operand&0xFF)) < 0x20) { // Run the first alone
+		inst = &u.info;
+		opcode = u.opcode;
+		return true;
+	}
+	OP = OP2 = ADDR = 0;
+	execute(u2);
+	fusedInfo = InstInfo{uint8_t(c), u2.info.r, u2.info.w, true};
+	inst = &fusedInfo;
+	opcode = u2.opcode;
+	return true;
 }
 
-void HD6303R::extend() {
-	ADDR = memory[PC++]<<8;
-	ADDR |= memory[PC++];
-	OP = memory[ADDR];
+// Native routines /////////////////////////////
+
+void HD6303R::addRoutine(uint16_t pc, Routine r) {
+	if(pc < ROM || routines.size() > 0xFF) return;
+	routineAt[pc-ROM] = routines.size();
+	routines.push_back(r);
 }
 
-void HD6303R::extend16() {
-	ADDR = memory[PC++]<<8;
-	ADDR |= memory[PC++];
-	OP2 = getm16(ADDR);
+// Run the routine at PC as one step, if it ends before the next event
+bool HD6303R::stepRoutine() {
+	Routine r = routines[routineAt[PC-ROM]];
+	int max = std::min<int64_t>(std::min(fuseLimit, 0xFFFF), int64_t(nextEvent - cycle) - 1);
+	if(max <= 0) return false;
+	int c = lockstep ? checkRoutine(r, max) : (this->*r)(max);
+	if(!c) return false;
+	fusedInfo = InstInfo{uint16_t(c), false, false, true};
+	inst = &fusedInfo;
+	return true;
 }
 
+// Lockstep validation: run the routine, then interpret the code from the
+// same state for the same cycles, and report the first difference. The
+// interpreted result stands, and a routine that differed is removed.
+// Only for debugging: it copies all of memory, twice.
+int HD6303R::checkRoutine(Routine r, int max) {
+	uint16_t pc = PC;
+	uint64_t regs = packRegs();
+	std::vector<uint8_t> before(memory, memory+0x10000);
+	int c = (this->*r)(max);
+	if(!c) return 0;
 
-void HD6303R::immed2() {
-	OP = memory[PC++];
-}
+	uint16_t hlePC = PC;
+	uint64_t hleRegs = packRegs();
+	std::vector<uint8_t> after(memory, memory+0x10000);
+	std::copy(before.begin(), before.end(), memory);
+	PC = pc;
+	A = regs;
+	B = regs>>8;
+	setCCR(regs>>16);
+	IX = regs>>24;
+	SP = regs>>40;
+	int t = 0;
+	while(t < c) {
+		opcode = memory[PC++];
+		inst = &instInfo[opcode];
+		if(!inst->legal) break;
+		OP = OP2 = ADDR = 0;
+		execute();
+		t += inst->cycles;
+	}
 
-void HD6303R::immed3() {
-	OP2 = memory[PC++]<<8;
-	OP2 |= memory[PC++];
+	int addr = 0;
+	while(addr < 0x10000 && memory[addr] == after[addr]) addr++;
+	if(t != c || PC != hlePC || packRegs() != hleRegs || addr < 0x10000) {
+		fprintf(stderr, "Routine %04X differs: ", pc);
+		if(t != c) fprintf(stderr, "cycles %d, interpreted %d\n", c, t);
+		else if(PC != hlePC) fprintf(stderr, "PC=%04X, interpreted %04X\n", hlePC, PC);
+		else if(packRegs() != hleRegs) fprintf(stderr, "A B CCR IX SP=%012lX, interpreted %012lX\n",
+			hleRegs, packRegs());
+		else fprintf(stderr, "memory %04X=%02X, interpreted %02X\n", addr, after[addr], memory[addr]);
+		routineAt[pc-ROM] = 0;
+	}
+	return t;
 }
 
-void HD6303R::implied() { } 
+// Idle loops ////////////////////////////////
 
-void HD6303R::index2() {
-	ADDR = IX + memory[PC++]; // Unsigned add
-	OP = memory[ADDR];
-}
+// Called after the BRA back to a loop head, or an instruction of a pass
+// being recorded, before the step's cycles are counted
+void HD6303R::idleLoop(int limit) {
+	if(idleStep < 0) { // At a loop head
+		if(PC == idleHead && idleLength && idleSkip(limit)) return;
+		if(cycle < idleRetry) return;
+		idleHead = PC;
+		idleLength = idleStep = idlePasses = idleCycles = 0;
+		return;
+	}
+
+	// Nothing but plain RAM, and no sleep
+	const Instruction &i = instructions[opcode];
+	bool stack = is(i.mode, "id") || is(i.group, "jsr "); // Writes only the stack
+	if(halt || uint16_t(ADDR-1) < 0x1F || (inst->w && !stack && writeHook[ADDR>>8])
+		|| idleStep == IdleSteps) {
+		idleFail();
+		return;
+	}
+	IdleStep &s = idlePass[idlePasses&1][idleStep++];
+	s.regs = packRegs();
+	s.mem = PC | uint64_t(ADDR)<<16 | uint64_t(memory[ADDR])<<32 | uint64_t(memory[uint16_t(ADDR+1)])<<40;
+	idleCycles += inst->cycles;
+	if(PC != idleHead) return;
 
-void HD6303R::index16() {
-	ADDR = IX + memory[PC++]; // Unsigned add
-	OP2 = getm16(ADDR);
+	// End of a pass. If it repeated the last one exactly, this state is
+	// a fixed point: keep the memory either accessed, including the stack
+	// above the head's SP that was pulled
+	if(idlePasses && idleStep == idlePrev
+			&& !memcmp(idlePass[0], idlePass[1], idleStep*sizeof(IdleStep))) {
+		idleN = 0;
+		uint16_t top = SP;
+		for(int n=0; n<idleStep; n++) {
+			uint16_t a = idlePass[0][n].mem>>16;
+			if(a) {
+				idleAddr[idleN++] = a;
+				idleAddr[idleN++] = a+1;
+			}
+			top = std::max(top, uint16_t(idlePass[0][n].regs>>40));
+		}
+		if(top - SP > 2*IdleSteps) {
+			idleFail();
+			return;
+		}
+		for(uint16_t a=SP+1; a<=top && a; a++) idleAddr[idleN++] = a;
+		for(int n=0; n<idleN; n++) idleData[n] = memory[idleAddr[n]];
+		idleRegs = s.regs;
+		idleLength = idleCycles;
+		idleStep = -1;
+		idleBackoff = 1024;
+		idleSkip(limit);
+		return;
+	}
+	if(++idlePasses == 4) {
+		idleFail();
+		return;
+	}
+	idlePrev = idleStep;
+	idleStep = idleCycles = 0;
 }
-void HD6303R::index3() { // AIM
-	OP = memory[ PC++ ];
-	ADDR = IX + memory[PC++];
+
+// At a fixed point loop head: if nothing the passes access has changed,
+// make the step take as many more passes as fit. False if it has.
+bool HD6303R::idleSkip(int limit) {
+	if(packRegs() != idleRegs) return false;
+	for(int n=0; n<idleN; n++) if(memory[idleAddr[n]] != idleData[n]) return false;
+	int c = inst->cycles;
+	int64_t room = std::min<int64_t>(std::min(limit, 0xFFFF), int64_t(nextEvent - cycle) - 1) - c;
+	if(room >= idleLength) {
+		fusedInfo = InstInfo{uint16_t(c + room/idleLength*idleLength), inst->r, inst->w, true};
+		inst = &fusedInfo;
+	}
+	return true;
 }
 
+// Not an idle loop, so don't record another for a while
+void HD6303R::idleFail() {
+	idleStep = -1;
+	idleRetry = cycle + idleBackoff;
+	idleBackoff = std::min(2*idleBackoff, 1<<20);
+}
@@ -0,0 +1,261 @@
+/**
+ *  VDX7 - Virtual DX7 synthesizer emulation
+ *  Copyright (C) 2023  chiaccona@gmail.com 
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+**/
+
+// HD6303R instruction set table
+//
+// Each entry is expanded through the OPCODE() macro, which must be defined
+// before including this file (it is deliberately not include-guarded). The
+// same table generates the disassembly metadata, the timing table used by the
+// main loop, and the instruction bodies of the dispatch engine, so an opcode
+// is only ever described in one place.
+//
+// The code is a brace-enclosed statement executed in the scope of HD6303R.
+// Code that reads or sets H, N, Z, V or C directly, rather than through the
+// CCR utilities, first calls flags() for them (see LAZY_FLAGS in HD6303R.h).
+
+//     OP    GRP     INST    AM   R  W Byt Cyc Code
+OPCODE(0x89, "adc ", "adca", "im", 0, 0, 2,  2, { immed2  (); flags(fC); R=A+OP+C; A8(A,OP,R); A=R; })
+OPCODE(0x99, "adc ", "adca", "di", 1, 0, 2,  3, { direct2 (); flags(fC); R=A+OP+C; A8(A,OP,R); A=R; })
+OPCODE(0xa9, "adc ", "adca", "in", 1, 0, 2,  4, { index2  (); flags(fC); R=A+OP+C; A8(A,OP,R); A=R; })
+OPCODE(0xb9, "adc ", "adca", "ex", 1, 0, 3,  4, { extend  (); flags(fC); R=A+OP+C; A8(A,OP,R); A=R; })
+OPCODE(0xc9, "adc ", "adcb", "im", 0, 0, 2,  2, { immed2  (); flags(fC); R=B+OP+C; A8(B,OP,R); B=R; })
+OPCODE(0xd9, "adc ", "adcb", "di", 1, 0, 2,  3, { direct2 (); flags(fC); R=B+OP+C; A8(B,OP,R); B=R; })
+OPCODE(0xe9, "adc ", "adcb", "in", 1, 0, 2,  4, { index2  (); flags(fC); R=B+OP+C; A8(B,OP,R); B=R; })
+OPCODE(0xf9, "adc ", "adcb", "ex", 1, 0, 3,  4, { extend  (); flags(fC); R=B+OP+C; A8(B,OP,R); B=R; })
+OPCODE(0x1b, "add ", "aba ", "id", 0, 0, 1,  1, { implied (); R=A+B; A8(A,B,R); A=R; })
+OPCODE(0x3a, "add ", "abx ", "id", 0, 0, 1,  1, { implied (); IX+=B; })
+OPCODE(0x8b, "add ", "adda", "im", 0, 0, 2,  2, { immed2  (); R=A+OP; A8(A,OP,R); A=R; })
+OPCODE(0x9b, "add ", "adda", "di", 1, 0, 2,  3, { direct2 (); R=A+OP; A8(A,OP,R); A=R; })
+OPCODE(0xab, "add ", "adda", "in", 1, 0, 2,  4, { index2  (); R=A+OP; A8(A,OP,R); A=R; })
+OPCODE(0xbb, "add ", "adda", "ex", 1, 0, 3,  4, { extend  (); R=A+OP; A8(A,OP,R); A=R; })
+OPCODE(0xcb, "add ", "addb", "im", 0, 0, 2,  2, { immed2  (); R=B+OP; A8(B,OP,R); B=R; })
+OPCODE(0xdb, "add ", "addb", "di", 1, 0, 2,  3, { direct2 (); R=B+OP; A8(B,OP,R); B=R; })
+OPCODE(0xeb, "add ", "addb", "in", 1, 0, 2,  4, { index2  (); R=B+OP; A8(B,OP,R); B=R; })
+OPCODE(0xfb, "add ", "addb", "ex", 1, 0, 3,  4, { extend  (); R=B+OP; A8(B,OP,R); B=R; })
+OPCODE(0xc3, "add ", "addd", "im", 0, 0, 3,  3, { immed3  (); R2=D+OP2; A16(D,OP2,R2); D=R2; })
+OPCODE(0xd3, "add ", "addd", "di", 1, 0, 2,  4, { direct16(); R2=D+OP2; A16(D,OP2,R2); D=R2; })
+OPCODE(0xe3, "add ", "addd", "in", 1, 0, 2,  5, { index16 (); R2=D+OP2; A16(D,OP2,R2); D=R2; })
+OPCODE(0xf3, "add ", "addd", "ex", 1, 0, 3,  5, { extend16(); R2=D+OP2; A16(D,OP2,R2); D=R2; })
+OPCODE(0x61, "and ", "aim ", "in", 0, 1, 3,  7, { index3  (); M[ADDR]&=OP; L8(M[ADDR]); })
+OPCODE(0x71, "and ", "aim ", "di", 0, 1, 3,  6, { direct3 (); M[ADDR]&=OP; L8(M[ADDR]); })
+OPCODE(0x84, "and ", "anda", "im", 0, 0, 2,  2, { immed2  (); A&=OP; L8(A); })
+OPCODE(0x94, "and ", "anda", "di", 1, 0, 2,  3, { direct2 (); A&=OP; L8(A); })
+OPCODE(0xa4, "and ", "anda", "in", 1, 0, 2,  4, { index2  (); A&=OP; L8(A); })
+OPCODE(0xb4, "and ", "anda", "ex", 1, 0, 3,  4, { extend  (); A&=OP; L8(A); })
+OPCODE(0xc4, "and ", "andb", "im", 0, 0, 2,  2, { immed2  (); B&=OP; L8(B); })
+OPCODE(0xd4, "and ", "andb", "di", 1, 0, 2,  3, { direct2 (); B&=OP; L8(B); })
+OPCODE(0xe4, "and ", "andb", "in", 1, 0, 2,  4, { index2  (); B&=OP; L8(B); })
+OPCODE(0xf4, "and ", "andb", "ex", 1, 0, 3,  4, { extend  (); B&=OP; L8(B); })
+OPCODE(0x68, "asl ", "asl ", "in", 1, 1, 2,  6, { index2  (); asl(M[ADDR]); })
+OPCODE(0x78, "asl ", "asl ", "ex", 1, 1, 3,  6, { extend  (); asl(M[ADDR]); })
+OPCODE(0x48, "asl ", "asla", "id", 0, 0, 1,  1, { implied (); asl(A); })
+OPCODE(0x58, "asl ", "aslb", "id", 0, 0, 1,  1, { implied (); asl(B); })
+OPCODE(0x05, "asl ", "asld", "id", 0, 0, 1,  1, { implied (); asld(D); })
+OPCODE(0x67, "asr ", "asr ", "in", 1, 1, 2,  6, { index2  (); asr(M[ADDR]); })
+OPCODE(0x77, "asr ", "asr ", "ex", 1, 1, 3,  6, { extend  (); asr(M[ADDR]); })
+OPCODE(0x47, "asr ", "asra", "id", 0, 0, 1,  1, { implied (); asr(A); })
+OPCODE(0x57, "asr ", "asrb", "id", 0, 0, 1,  1, { implied (); asr(B); })
+OPCODE(0x85, "bit ", "bita", "im", 0, 0, 2,  2, { immed2  (); L8(A&OP); })
+OPCODE(0x95, "bit ", "bita", "di", 1, 0, 2,  3, { direct2 (); L8(A&OP); })
+OPCODE(0xa5, "bit ", "bita", "in", 1, 0, 2,  4, { index2  (); L8(A&OP); })
+OPCODE(0xb5, "bit ", "bita", "ex", 1, 0, 3,  4, { extend  (); L8(A&OP); })
+OPCODE(0xc5, "bit ", "bitb", "im", 0, 0, 2,  2, { immed2  (); L8(B&OP); })
+OPCODE(0xd5, "bit ", "bitb", "di", 1, 0, 2,  3, { direct2 (); L8(B&OP); })
+OPCODE(0xe5, "bit ", "bitb", "in", 1, 0, 2,  4, { index2  (); L8(B&OP); })
+OPCODE(0xf5, "bit ", "bitb", "ex", 1, 0, 3,  4, { extend  (); L8(B&OP); })
+OPCODE(0x24, "bra ", "bcc ", "im", 0, 0, 2,  3, { immed2  (); flags(fC); bra(!C); })
+OPCODE(0x25, "bra ", "bcs ", "im", 0, 0, 2,  3, { immed2  (); flags(fC); bra(C); })
+OPCODE(0x27, "bra ", "beq ", "im", 0, 0, 2,  3, { immed2  (); flags(fZ); bra(Z); })
+OPCODE(0x2c, "bra ", "bge ", "im", 0, 0, 2,  3, { immed2  (); flags(fN|fV); bra(N^(V==0)); })
+OPCODE(0x2e, "bra ", "bgt ", "im", 0, 0, 2,  3, { immed2  (); flags(fZ|fN|fV); bra(!(Z|(N^V))); })
+OPCODE(0x22, "bra ", "bhi ", "im", 0, 0, 2,  3, { immed2  (); flags(fC|fZ); bra(!(C|Z)); })
+OPCODE(0x2f, "bra ", "ble ", "im", 0, 0, 2,  3, { immed2  (); flags(fZ|fN|fV); bra(Z|(N^V)); })
+OPCODE(0x23, "bra ", "bls ", "im", 0, 0, 2,  3, { immed2  (); flags(fC|fZ); bra(C|Z); })
+OPCODE(0x2d, "bra ", "blt ", "im", 0, 0, 2,  3, { immed2  (); flags(fN|fV); bra(N^V); })
+OPCODE(0x2b, "bra ", "bmi ", "im", 0, 0, 2,  3, { immed2  (); flags(fN); bra(N); })
+OPCODE(0x26, "bra ", "bne ", "im", 0, 0, 2,  3, { immed2  (); flags(fZ); bra(!Z); })
+OPCODE(0x2a, "bra ", "bpl ", "im", 0, 0, 2,  3, { immed2  (); flags(fN); bra(!N); })
+OPCODE(0x20, "bra ", "bra ", "im", 0, 0, 2,  3, { immed2  (); bra(1); })
+OPCODE(0x21, "bra ", "brn ", "im", 0, 0, 2,  3, { immed2  (); bra(0); })
+OPCODE(0x28, "bra ", "bvc ", "im", 0, 0, 2,  3, { immed2  (); flags(fV); bra(!V); })
+OPCODE(0x29, "bra ", "bvs ", "im", 0, 0, 2,  3, { immed2  (); flags(fV); bra(V); })
+OPCODE(0x8d, "bsr ", "bsr ", "im", 0, 0, 2,  5, { immed2  (); bsr(); })
+OPCODE(0x0c, "clr ", "clc ", "id", 0, 0, 1,  1, { implied (); flags(fC); C=0; })
+OPCODE(0x0e, "clr ", "cli ", "id", 0, 0, 1,  1, { implied (); I=0; })
+OPCODE(0x6f, "clr ", "clr ", "in", 1, 1, 2,  5, { index2  (); M[ADDR]=0; flags(fN|fZ|fV|fC); N=V=C=0; Z=1; })
+OPCODE(0x7f, "clr ", "clr ", "ex", 1, 1, 3,  5, { extend  (); M[ADDR]=0; flags(fN|fZ|fV|fC); N=V=C=0; Z=1; })
+OPCODE(0x4f, "clr ", "clra", "id", 0, 0, 1,  1, { implied (); A=0; flags(fN|fZ|fV|fC); N=V=C=0; Z=1; })
+OPCODE(0x5f, "clr ", "clrb", "id", 0, 0, 1,  1, { implied (); B=0; flags(fN|fZ|fV|fC); N=V=C=0; Z=1; })
+OPCODE(0x0a, "clr ", "clv ", "id", 0, 0, 1,  1, { implied (); flags(fV); V=0; })
+OPCODE(0x11, "cmp ", "cba ", "id", 0, 0, 1,  1, { implied (); R=A-B; S8(A,B,R); })
+OPCODE(0x81, "cmp ", "cmpa", "im", 0, 0, 2,  2, { immed2  (); R=A-OP; S8(A,OP,R); })
+OPCODE(0x91, "cmp ", "cmpa", "di", 1, 0, 2,  3, { direct2 (); R=A-OP; S8(A,OP,R); })
+OPCODE(0xa1, "cmp ", "cmpa", "in", 1, 0, 2,  4, { index2  (); R=A-OP; S8(A,OP,R); })
+OPCODE(0xb1, "cmp ", "cmpa", "ex", 1, 0, 3,  4, { extend  (); R=A-OP; S8(A,OP,R); })
+OPCODE(0xc1, "cmp ", "cmpb", "im", 0, 0, 2,  2, { immed2  (); R=B-OP; S8(B,OP,R); })
+OPCODE(0xd1, "cmp ", "cmpb", "di", 1, 0, 2,  3, { direct2 (); R=B-OP; S8(B,OP,R); })
+OPCODE(0xe1, "cmp ", "cmpb", "in", 1, 0, 2,  4, { index2  (); R=B-OP; S8(B,OP,R); })
+OPCODE(0xf1, "cmp ", "cmpb", "ex", 1, 0, 3,  4, { extend  (); R=B-OP; S8(B,OP,R); })
+OPCODE(0x8c, "cmp ", "cpx ", "im", 0, 0, 3,  3, { immed3  (); R2=IX-OP2; S16(IX,OP2,R2); })
+OPCODE(0x9c, "cmp ", "cpx ", "di", 1, 0, 2,  4, { direct16(); R2=IX-OP2; S16(IX,OP2,R2); })
+OPCODE(0xac, "cmp ", "cpx ", "in", 1, 0, 2,  5, { index16 (); R2=IX-OP2; S16(IX,OP2,R2); })
+OPCODE(0xbc, "cmp ", "cpx ", "ex", 1, 0, 3,  5, { extend16(); R2=IX-OP2; S16(IX,OP2,R2); })
+OPCODE(0x63, "com ", "com ", "in", 1, 1, 2,  6, { index2  (); M[ADDR]=~OP; flags(fC); C=1; L8(M[ADDR]); })
+OPCODE(0x73, "com ", "com ", "ex", 1, 1, 3,  6, { extend  (); M[ADDR]=~OP; flags(fC); C=1; L8(M[ADDR]); })
+OPCODE(0x43, "com ", "coma", "id", 0, 0, 1,  1, { implied (); A=~A; flags(fC); C=1; L8(A); })
+OPCODE(0x53, "com ", "comb", "id", 0, 0, 1,  1, { implied (); B=~B; flags(fC); C=1; L8(B); })
+OPCODE(0x19, "daa ", "daa ", "id", 0, 0, 1,  2, { implied (); daa(); })
+OPCODE(0x6a, "dec ", "dec ", "in", 1, 1, 2,  6, { index2  (); M[ADDR]--; D8(M[ADDR]); })
+OPCODE(0x7a, "dec ", "dec ", "ex", 1, 1, 3,  6, { extend  (); M[ADDR]--; D8(M[ADDR]); })
+OPCODE(0x4a, "dec ", "deca", "id", 0, 0, 1,  1, { implied (); A--; D8(A); })
+OPCODE(0x5a, "dec ", "decb", "id", 0, 0, 1,  1, { implied (); B--; D8(B); })
+OPCODE(0x34, "dec ", "des ", "id", 0, 0, 1,  1, { implied (); SP--; })
+OPCODE(0x09, "dec ", "dex ", "id", 0, 0, 1,  1, { implied (); IX--; flags(fZ); Z=!IX; })
+OPCODE(0x65, "eor ", "eim ", "in", 0, 1, 3,  7, { index3  (); M[ADDR]^=OP; L8(M[ADDR]); })
+OPCODE(0x75, "eor ", "eim ", "di", 0, 1, 3,  6, { direct3 (); M[ADDR]^=OP; L8(M[ADDR]); })
+OPCODE(0x88, "eor ", "eora", "im", 0, 0, 2,  2, { immed2  (); A^=OP; L8(A); })
+OPCODE(0x98, "eor ", "eora", "di", 1, 0, 2,  3, { direct2 (); A^=OP; L8(A); })
+OPCODE(0xa8, "eor ", "eora", "in", 1, 0, 2,  4, { index2  (); A^=OP; L8(A); })
+OPCODE(0xb8, "eor ", "eora", "ex", 1, 0, 3,  4, { extend  (); A^=OP; L8(A); })
+OPCODE(0xc8, "eor ", "eorb", "im", 0, 0, 2,  2, { immed2  (); B^=OP; L8(B); })
+OPCODE(0xd8, "eor ", "eorb", "di", 1, 0, 2,  3, { direct2 (); B^=OP; L8(B); })
+OPCODE(0xe8, "eor ", "eorb", "in", 1, 0, 2,  4, { index2  (); B^=OP; L8(B); })
+OPCODE(0xf8, "eor ", "eorb", "ex", 1, 0, 3,  4, { extend  (); B^=OP; L8(B); })
+OPCODE(0x18, "exg ", "xgdx", "id", 0, 0, 1,  2, { implied (); OP2=IX; IX=D; D=OP2; })
+OPCODE(0x6c, "inc ", "inc ", "in", 1, 1, 2,  6, { index2  (); M[ADDR]++; I8(M[ADDR]); })
+OPCODE(0x7c, "inc ", "inc ", "ex", 1, 1, 3,  6, { extend  (); M[ADDR]++; I8(M[ADDR]); })
+OPCODE(0x4c, "inc ", "inca", "id", 0, 0, 1,  1, { implied (); A++; I8(A); })
+OPCODE(0x5c, "inc ", "incb", "id", 0, 0, 1,  1, { implied (); B++; I8(B); })
+OPCODE(0x31, "inc ", "ins ", "id", 0, 0, 1,  1, { implied (); SP++               ;})
+OPCODE(0x08, "inc ", "inx ", "id", 0, 0, 1,  1, { implied (); IX++; flags(fZ); Z=!IX; })
+OPCODE(0x6e, "jmp ", "jmp ", "in", 1, 0, 2,  3, { index2  (); PC=ADDR; })
+OPCODE(0x7e, "jmp ", "jmp ", "ex", 1, 0, 3,  3, { extend  (); PC=ADDR; })
+OPCODE(0x9d, "jsr ", "jsr ", "di", 1, 1, 2,  5, { direct2 (); push(PC); PC=ADDR; })
+OPCODE(0xad, "jsr ", "jsr ", "in", 1, 1, 2,  5, { index2  (); push(PC); PC=ADDR; })
+OPCODE(0xbd, "jsr ", "jsr ", "ex", 1, 1, 3,  6, { extend  (); push(PC); PC=ADDR; })
+OPCODE(0x86, "ld  ", "ldaa", "im", 0, 0, 2,  2, { immed2  (); A=OP; L8(A); })
+OPCODE(0x96, "ld  ", "ldaa", "di", 1, 0, 2,  3, { direct2 (); A=OP; L8(A); })
+OPCODE(0xa6, "ld  ", "ldaa", "in", 1, 0, 2,  4, { index2  (); A=OP; L8(A); })
+OPCODE(0xb6, "ld  ", "ldaa", "ex", 1, 0, 3,  4, { extend  (); A=OP; L8(A); })
+OPCODE(0xc6, "ld  ", "ldab", "im", 0, 0, 2,  2, { immed2  (); B=OP; L8(B); })
+OPCODE(0xd6, "ld  ", "ldab", "di", 1, 0, 2,  3, { direct2 (); B=OP; L8(B); })
+OPCODE(0xe6, "ld  ", "ldab", "in", 1, 0, 2,  4, { index2  (); B=OP; L8(B); })
+OPCODE(0xf6, "ld  ", "ldab", "ex", 1, 0, 3,  4, { extend  (); B=OP; L8(B); })
+OPCODE(0xcc, "ld  ", "ldd ", "im", 0, 0, 3,  3, { immed3  (); D=OP2; L16(D); })
+OPCODE(0xdc, "ld  ", "ldd ", "di", 1, 0, 2,  4, { direct2 (); D=getm16(ADDR); L16(D); })
+OPCODE(0xec, "ld  ", "ldd ", "in", 1, 0, 2,  5, { index2  (); D=getm16(ADDR); L16(D); })
+OPCODE(0xfc, "ld  ", "ldd ", "ex", 1, 0, 3,  5, { extend  (); D=getm16(ADDR); L16(D); })
+OPCODE(0x8e, "ld  ", "lds ", "im", 0, 0, 3,  3, { immed3  (); SP=OP2; L16(SP); })
+OPCODE(0x9e, "ld  ", "lds ", "di", 1, 0, 2,  4, { direct2 (); SP=getm16(ADDR); L16(SP); })
+OPCODE(0xae, "ld  ", "lds ", "in", 1, 0, 2,  5, { index2  (); SP=getm16(ADDR); L16(SP); })
+OPCODE(0xbe, "ld  ", "lds ", "ex", 1, 0, 3,  5, { extend  (); SP=getm16(ADDR); L16(SP); })
+OPCODE(0xce, "ld  ", "ldx ", "im", 0, 0, 3,  3, { immed3  (); IX=OP2; L16(IX); })
+OPCODE(0xde, "ld  ", "ldx ", "di", 1, 0, 2,  4, { direct2 (); IX=getm16(ADDR); L16(IX); })
+OPCODE(0xee, "ld  ", "ldx ", "in", 1, 0, 2,  5, { index2  (); IX=getm16(ADDR); L16(IX); })
+OPCODE(0xfe, "ld  ", "ldx ", "ex", 1, 0, 3,  5, { extend  (); IX=getm16(ADDR); L16(IX); })
+OPCODE(0x64, "lsr ", "lsr ", "in", 1, 1, 2,  6, { index2  (); lsr(M[ADDR]); })
+OPCODE(0x74, "lsr ", "lsr ", "ex", 1, 1, 3,  6, { extend  (); lsr(M[ADDR]); })
+OPCODE(0x44, "lsr ", "lsra", "id", 0, 0, 1,  1, { implied (); lsr(A); })
+OPCODE(0x54, "lsr ", "lsrb", "id", 0, 0, 1,  1, { implied (); lsr(B); })
+OPCODE(0x04, "lsr ", "lsrd", "id", 0, 0, 1,  1, { implied (); lsrd(D); })
+OPCODE(0x3d, "mul ", "mul ", "id", 0, 0, 1,  7, { implied (); D=A*B; flags(fC); C=bit(D,7); })
+OPCODE(0x60, "neg ", "neg ", "in", 1, 1, 2,  6, { index2  (); M[ADDR]=-OP; I8(M[ADDR]); flags(fZ); C=!Z; })
+OPCODE(0x70, "neg ", "neg ", "ex", 1, 1, 3,  6, { extend  (); M[ADDR]=-OP; I8(M[ADDR]); flags(fZ); C=!Z; })
+OPCODE(0x40, "neg ", "nega", "id", 0, 1, 1,  1, { implied (); A=-A; I8(A); flags(fZ); C=!Z; })
+OPCODE(0x50, "neg ", "negb", "id", 0, 1, 1,  1, { implied (); B=-B; I8(B); flags(fZ); C=!Z; })
+OPCODE(0x01, "nop ", "nop ", "id", 0, 0, 1,  1, { implied (); })
+OPCODE(0x62, "or  ", "oim ", "in", 0, 1, 3,  7, { index3  (); M[ADDR]|=OP; V=0; L8(M[ADDR]); })
+OPCODE(0x72, "or  ", "oim ", "di", 0, 1, 3,  6, { direct3 (); M[ADDR]|=OP; V=0; L8(M[ADDR]); })
+OPCODE(0x8a, "or  ", "oraa", "im", 0, 0, 2,  2, { immed2  (); A|=OP; V=0; L8(A); })
+OPCODE(0x9a, "or  ", "oraa", "di", 1, 0, 2,  3, { direct2 (); A|=OP; V=0; L8(A); })
+OPCODE(0xaa, "or  ", "oraa", "in", 1, 0, 2,  4, { index2  (); A|=OP; V=0; L8(A); })
+OPCODE(0xba, "or  ", "oraa", "ex", 1, 0, 3,  4, { extend  (); A|=OP; V=0; L8(A); })
+OPCODE(0xca, "or  ", "orab", "im", 0, 0, 2,  2, { immed2  (); B|=OP; V=0; L8(B); })
+OPCODE(0xda, "or  ", "orab", "di", 1, 0, 2,  3, { direct2 (); B|=OP; V=0; L8(B); })
+OPCODE(0xea, "or  ", "orab", "in", 1, 0, 2,  4, { index2  (); B|=OP; V=0; L8(B); })
+OPCODE(0xfa, "or  ", "orab", "ex", 1, 0, 3,  4, { extend  (); B|=OP; V=0; L8(B); })
+OPCODE(0x32, "pull", "pula", "id", 0, 0, 1,  3, { implied (); A=M[++SP]; })
+OPCODE(0x33, "pull", "pulb", "id", 0, 0, 1,  3, { implied (); B=M[++SP]; })
+OPCODE(0x38, "pull", "pulx", "id", 0, 0, 1,  4, { implied (); pull(IX); })
+OPCODE(0x36, "push", "psha", "id", 0, 1, 1,  4, { implied (); M[SP--]=A; })
+OPCODE(0x37, "push", "pshb", "id", 0, 1, 1,  4, { implied (); M[SP--]=B; })
+OPCODE(0x3c, "push", "pshx", "id", 0, 1, 1,  5, { implied (); push(IX); })
+OPCODE(0x69, "rol ", "rol ", "in", 1, 1, 2,  6, { index2  (); rol(M[ADDR]); })
+OPCODE(0x79, "rol ", "rol ", "ex", 1, 1, 3,  6, { extend  (); rol(M[ADDR]); })
+OPCODE(0x49, "rol ", "rola", "id", 0, 0, 1,  1, { implied (); rol(A); })
+OPCODE(0x59, "rol ", "rolb", "id", 0, 0, 1,  1, { implied (); rol(B); })
+OPCODE(0x66, "ror ", "ror ", "in", 1, 1, 2,  6, { index2  (); ror(M[ADDR]); })
+OPCODE(0x76, "ror ", "ror ", "ex", 1, 1, 3,  6, { extend  (); ror(M[ADDR]); })
+OPCODE(0x46, "ror ", "rora", "id", 0, 0, 1,  1, { implied (); ror(A); })
+OPCODE(0x56, "ror ", "rorb", "id", 0, 0, 1,  1, { implied (); ror(B); })
+OPCODE(0x3b, "rts ", "rti ", "id", 0, 0, 1, 10, { implied (); rti(); })
+OPCODE(0x39, "rts ", "rts ", "id", 0, 0, 1,  5, { implied (); pull(PC); })
+OPCODE(0x82, "sbc ", "sbca", "im", 0, 0, 2,  2, { immed2  (); flags(fC); R=A-OP-C; S8(A,OP,R); A=R; })
+OPCODE(0x92, "sbc ", "sbca", "di", 1, 0, 2,  3, { direct2 (); flags(fC); R=A-OP-C; S8(A,OP,R); A=R; })
+OPCODE(0xa2, "sbc ", "sbca", "in", 1, 0, 2,  4, { index2  (); flags(fC); R=A-OP-C; S8(A,OP,R); A=R; })
+OPCODE(0xb2, "sbc ", "sbca", "ex", 1, 0, 3,  4, { extend  (); flags(fC); R=A-OP-C; S8(A,OP,R); A=R; })
+OPCODE(0xc2, "sbc ", "sbcb", "im", 0, 0, 2,  2, { immed2  (); flags(fC); R=B-OP-C; S8(B,OP,R); B=R; })
+OPCODE(0xd2, "sbc ", "sbcb", "di", 1, 0, 2,  3, { direct2 (); flags(fC); R=B-OP-C; S8(B,OP,R); B=R; })
+OPCODE(0xe2, "sbc ", "sbcb", "in", 1, 0, 2,  4, { index2  (); flags(fC); R=B-OP-C; S8(B,OP,R); B=R; })
+OPCODE(0xf2, "sbc ", "sbcb", "ex", 1, 0, 3,  4, { extend  (); flags(fC); R=B-OP-C; S8(B,OP,R); B=R; })
+OPCODE(0x0d, "set ", "sec ", "id", 0, 0, 1,  1, { implied (); flags(fC); C=1; })
+OPCODE(0x0f, "set ", "sei ", "id", 0, 0, 1,  1, { implied (); I=1; })
+OPCODE(0x0b, "set ", "sev ", "id", 0, 0, 1,  1, { implied (); flags(fV); V=1; })
+OPCODE(0x97, "st  ", "staa", "di", 1, 1, 2,  3, { direct2 (); M[ADDR]=A; V=0; L8(M[ADDR]); })
+OPCODE(0xa7, "st  ", "staa", "in", 1, 1, 2,  4, { index2  (); M[ADDR]=A; V=0; L8(M[ADDR]); })
+OPCODE(0xb7, "st  ", "staa", "ex", 1, 1, 3,  4, { extend  (); M[ADDR]=A; V=0; L8(M[ADDR]); })
+OPCODE(0xd7, "st  ", "stab", "di", 1, 1, 2,  3, { direct2 (); M[ADDR]=B; V=0; L8(M[ADDR]); })
+OPCODE(0xe7, "st  ", "stab", "in", 1, 1, 2,  4, { index2  (); M[ADDR]=B; V=0; L8(M[ADDR]); })
+OPCODE(0xf7, "st  ", "stab", "ex", 1, 1, 3,  4, { extend  (); M[ADDR]=B; V=0; L8(M[ADDR]); })
+OPCODE(0xdd, "st  ", "std ", "di", 1, 1, 2,  4, { direct2 (); stom16(ADDR,D); L16(D); })
+OPCODE(0xed, "st  ", "std ", "in", 1, 1, 2,  5, { index2  (); stom16(ADDR,D); L16(D); })
+OPCODE(0xfd, "st  ", "std ", "ex", 1, 1, 3,  5, { extend  (); stom16(ADDR,D); L16(D); })
+OPCODE(0x9f, "st  ", "sts ", "di", 1, 1, 2,  4, { direct2 (); stom16(ADDR,SP); L16(SP); })
+OPCODE(0xaf, "st  ", "sts ", "in", 1, 1, 2,  5, { index2  (); stom16(ADDR,SP); L16(SP); })
+OPCODE(0xbf, "st  ", "sts ", "ex", 1, 1, 3,  5, { extend  (); stom16(ADDR,SP); L16(SP); })
+OPCODE(0xdf, "st  ", "stx ", "di", 1, 1, 2,  4, { direct2 (); stom16(ADDR,IX); L16(IX); })
+OPCODE(0xef, "st  ", "stx ", "in", 1, 1, 2,  5, { index2  (); stom16(ADDR,IX); L16(IX); })
+OPCODE(0xff, "st  ", "stx ", "ex", 1, 1, 3,  5, { extend  (); stom16(ADDR,IX); L16(IX); })
+OPCODE(0x10, "sub ", "sba ", "id", 0, 0, 1,  1, { implied (); R=A-B; S8(A,B,R); A=R; })
+OPCODE(0x80, "sub ", "suba", "im", 0, 0, 2,  2, { immed2  (); R=A-OP; S8(A,OP,R); A=R; })
+OPCODE(0x90, "sub ", "suba", "di", 1, 0, 2,  3, { direct2 (); R=A-OP; S8(A,OP,R); A=R; })
+OPCODE(0xa0, "sub ", "suba", "in", 1, 0, 2,  4, { index2  (); R=A-OP; S8(A,OP,R); A=R; })
+OPCODE(0xb0, "sub ", "suba", "ex", 1, 0, 3,  4, { extend  (); R=A-OP; S8(A,OP,R); A=R; })
+OPCODE(0xc0, "sub ", "subb", "im", 0, 0, 2,  2, { immed2  (); R=B-OP; S8(B,OP,R); B=R; })
+OPCODE(0xd0, "sub ", "subb", "di", 1, 0, 2,  3, { direct2 (); R=B-OP; S8(B,OP,R); B=R; })
+OPCODE(0xe0, "sub ", "subb", "in", 1, 0, 2,  4, { index2  (); R=B-OP; S8(B,OP,R); B=R; })
+OPCODE(0xf0, "sub ", "subb", "ex", 1, 0, 3,  4, { extend  (); R=B-OP; S8(B,OP,R); B=R; })
+OPCODE(0x83, "sub ", "subd", "im", 0, 0, 3,  3, { immed3  (); R2=D-OP2; S16(D,OP2,R2); D=R2; })
+OPCODE(0x93, "sub ", "subd", "di", 1, 0, 2,  4, { direct16(); R2=D-OP2; S16(D,OP2,R2); D=R2; })
+OPCODE(0xa3, "sub ", "subd", "in", 1, 0, 2,  5, { index16 (); R2=D-OP2; S16(D,OP2,R2); D=R2; })
+OPCODE(0xb3, "sub ", "subd", "ex", 1, 0, 3,  5, { extend16(); R2=D-OP2; S16(D,OP2,R2); D=R2; })
+OPCODE(0x3f, "swi ", "swi ", "id", 0, 0, 1, 12, { implied (); swi(); })
+OPCODE(0x16, "tfr ", "tab ", "id", 0, 0, 1,  1, { implied (); B=A; V=0; L8(B); })
+OPCODE(0x06, "tfr ", "tap ", "id", 0, 0, 1,  1, { implied (); setCCR(A); })
+OPCODE(0x17, "tfr ", "tba ", "id", 0, 0, 1,  1, { implied (); A=B; V=0; L8(A); })
+OPCODE(0x07, "tfr ", "tpa ", "id", 0, 0, 1,  1, { implied (); A=getCCR(); })
+OPCODE(0x30, "tfr ", "tsx ", "id", 0, 0, 1,  1, { implied (); IX=SP+1; })
+OPCODE(0x35, "tfr ", "txs ", "id", 0, 0, 1,  1, { implied (); SP=IX-1; })
+OPCODE(0x6b, "tst ", "tim ", "in", 1, 0, 3,  5, { index3  (); V=0; L8(M[ADDR]&OP); })
+OPCODE(0x7b, "tst ", "tim ", "di", 1, 0, 3,  4, { direct3 (); V=0; L8(M[ADDR]&OP); })
+OPCODE(0x6d, "tst ", "tst ", "in", 1, 0, 2,  4, { index2  (); V=0; L8(OP); })
+OPCODE(0x7d, "tst ", "tst ", "ex", 1, 0, 3,  4, { extend  (); V=0; L8(OP); })
+OPCODE(0x4d, "tst ", "tsta", "id", 0, 0, 1,  1, { implied (); V=0; L8(A); })
+OPCODE(0x5d, "tst ", "tstb", "id", 0, 0, 1,  1, { implied (); V=0; L8(B); })
+OPCODE(0x1a, "wait", "slp ", "id", 0, 0, 1,  4, { implied (); isleep(); })
+OPCODE(0x3e, "wait", "wai ", "id", 0, 0, 1,  9, { implied (); wait(); })
@@ -0,0 +1,339 @@
+/**
+ *  VDX7 - Virtual DX7 synthesizer emulation
+ *  Copyright (C) 2023  chiaccona@gmail.com 
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+**/
+
+#pragma once
+
+// Inline instruction helpers, shared by the interpreter and the
+// recompiled firmware (see rom2cc.cc)
+
+#include "HD6303R.h"
+
+// CCR utilities /////////////////////////////
+#ifdef LAZY_FLAGS
+// Record an operation, evaluating any pending flags it doesn't set
+void HD6303R::lazy(uint8_t op, uint8_t mask, uint16_t op1, uint16_t op2, uint16_t r, uint16_t sign) {
+	flags(lazyMask & ~mask);
+	lazyOp = op;
+	lazyMask = mask;
+	lazy1 = op1;
+	lazy2 = op2;
+	lazyR = r;
+	lazySign = sign;
+}
+void HD6303R::A8(uint8_t op1, uint8_t op2, uint8_t r) { lazy(ADD, fH|fN|fZ|fV|fC, op1, op2, r, 1<<7); }
+void HD6303R::A16(uint16_t op1, uint16_t op2, uint16_t r) { lazy(ADD, fN|fZ|fV|fC, op1, op2, r, 1<<15); }
+void HD6303R::S8(uint8_t op1, uint8_t op2, uint8_t r) { lazy(SUB, fN|fZ|fV|fC, op1, op2, r, 1<<7); }
+void HD6303R::S16(uint16_t op1, uint16_t op2, uint16_t r) { lazy(SUB, fN|fZ|fV|fC, op1, op2, r, 1<<15); }
+void HD6303R::L8(uint8_t r) { lazy(LOGIC, fN|fZ|fV, 0, 0, r, 1<<7); }
+void HD6303R::L16(uint16_t r) { lazy(LOGIC, fN|fZ|fV, 0, 0, r, 1<<15); }
+void HD6303R::D8(uint8_t r) { lazy(DEC, fN|fZ|fV, 0, 0, r, 1<<7); }
+void HD6303R::I8(uint8_t r) { lazy(INC, fN|fZ|fV, 0, 0, r, 1<<7); }
+#else
+void HD6303R::A8(uint8_t op1, uint8_t op2, uint8_t r) { // additive arithmetic 8 bit
+	uint8_t c = (op1 & op2) | (op2 & ~r) | (~r & op1);
+	H = c & (1<<3);
+	N = r & (1<<7);
+	Z = !r;
+	V = ( (op1 & op2 & ~r) | (~op1 & ~op2 & r ) ) & (1<<7);
+	C = c & (1<<7);
+}
+void HD6303R::A16(uint16_t op1, uint16_t op2, uint16_t r) { // additive arithmetic 16 bit
+	N = r & (1<<15);
+	Z = !r;
+	V = ( (op1 & op2 & ~r) | (~op1 & ~op2 & r) ) & (1<<15);
+	C = ( (op1 & op2) | (op2 & ~r) | (~r & op1) ) & (1<<15);
+}
+void HD6303R::S8(uint8_t op1, uint8_t op2, uint8_t r) { // subtractive arithmetic 8 bit
+	N = r & (1<<7);
+	Z = !r;
+	V = ( (op1 & ~op2 & ~r) | (~op1 & op2 & r) ) & (1<<7);
+	C = ( (~op1 & op2) | (op2 & r) | (r & ~op1) ) & (1<<7);
+}
+void HD6303R::S16(uint16_t op1, uint16_t op2, uint16_t r) { // subtractive arithmetic 16 bit
+	N = r & (1<<15);
+	Z = !r;
+	V = ( (op1 & ~op2 & ~r) | (~op1 & op2 & r) ) & (1<<15);
+	C = ( (~op1 & op2) | (op2 & r) | (r & ~op1) ) & (1<<15);
+}
+void HD6303R::L8(uint8_t r) { // logical operations 8 bit
+	N = r & (1<<7);
+	Z = !r;
+	V = 0;
+}
+void HD6303R::L16(uint16_t r) { // logical operations 16 bit
+	N = r & (1<<15);
+	Z = !r;
+	V = 0;
+}
+void HD6303R::D8(uint8_t r) { // decrement 8 bit
+	N = r & (1<<7);
+	Z = !r;
+	V = (r==0x7F);
+}
+void HD6303R::I8(uint8_t r) { // increment 8 bit
+	N = r & (1<<7);
+	Z = !r;
+	V = (r==0x80);
+}
+#endif
+
+// Instruction helpers
+void HD6303R::isleep() { halt = true; }
+void HD6303R::wait() {
+	halt = true;
+	push(PC);
+	push(IX);
+	memory[SP--] = A;
+	memory[SP--] = B;
+	memory[SP--] = getCCR();
+}
+
+void HD6303R::bra(bool c) { if(c) PC += extend8(OP); }
+void HD6303R::bsr() { push(PC); PC += extend8(OP); }
+
+void HD6303R::asl(uint8_t &x) { // 8 bit
+	flags(fN|fZ|fV|fC);
+	C = bit(x,7);
+	x <<= 1;
+	N = bit(x,7);
+	Z = !x;
+	V = N^C;
+}
+
+void HD6303R::asld(uint16_t &x) { // 16 bit
+	flags(fN|fZ|fV|fC);
+	C = bit(x,15);
+	x <<= 1;
+	N = bit(x,15);
+	Z = !x;
+	V = N^C;
+}
+
+void HD6303R::asr(uint8_t &x) { // 8 bit
+	flags(fN|fZ|fV|fC);
+	C = bit(x,0);
+	x = int8_t(x)>>1;
+	N = bit(x,7);
+	Z = !x;
+	V = N^C;
+}
+
+void HD6303R::lsr(uint8_t &x) { // 8 bit
+	flags(fN|fZ|fV|fC);
+	C = bit(x,0);
+	x >>= 1;
+	N = 0;
+	Z = !x;
+	V = N^C;
+}
+
+void HD6303R::lsrd(uint16_t &x) { // 16 bit
+	flags(fN|fZ|fV|fC);
+	C = bit(x,0);
+	x >>= 1;
+	N = 0;
+	Z = !x;
+	V = N^C;
+}
+
+void HD6303R::rol(uint8_t &x) { // rotate left
+	flags(fN|fZ|fV|fC);
+	bool c = bit(x,7);
+	x <<= 1;
+	x |= C;
+	C = c;
+	N = 0;
+	Z = !x;
+	V = N^C;
+}
+
+void HD6303R::ror(uint8_t &x) { // rotate right
+	flags(fN|fZ|fV|fC);
+	bool c = bit(x,0);
+	x >>= 1;
+	x |= (C<<7);
+	C = c;
+	N = 0;
+	Z = !x;
+	V = N^C;
+}
+
+void HD6303R::pull(uint16_t &x) {
+	x = memory[++SP] << 8;
+	x |= memory[++SP];
+}
+
+void HD6303R::rti() {
+	setCCR(memory[++SP]);
+	B = memory[++SP];
+	A = memory[++SP];
+	pull(IX);
+	pull(PC);
+}
+
+void HD6303R::daa() {
+	flags(fH|fN|fZ|fC);
+	uint8_t c = 0;
+	uint8_t lsn = (A & 0x0F);
+	uint8_t msn = (A & 0xF0) >> 4;
+	if (H || (lsn > 9)) c |= 0x06;
+	if (C || (msn > 9) || ((msn > 8) && (lsn > 9))) c |= 0x60;
+	uint16_t t = uint16_t(A) + c;
+	C |= bit(t, 8);
+	A = uint8_t(t);
+	N = bit(A, 7);
+	Z = !A;
+}
+
+
+// Addressing modes /////////////////////////
+
+void HD6303R::direct2() {
+	ADDR = memory[PC++];
+	OP = memory[ADDR];
+}
+
+void HD6303R::direct16() {
+	ADDR = memory[PC++];
+	OP2 = getm16(ADDR);
+}
+
+void HD6303R::direct3() { // AIM
+	OP = memory[PC++];
+	ADDR = memory[PC++];
+}
+
+void HD6303R::extend() {
+	ADDR = memory[PC++]<<8;
+	ADDR |= memory[PC++];
+	OP = memory[ADDR];
+}
+
+void HD6303R::extend16() {
+	ADDR = memory[PC++]<<8;
+	ADDR |= memory[PC++];
+	OP2 = getm16(ADDR);
+}
+
+
+void HD6303R::immed2() {
+	OP = memory[PC++];
+}
+
+void HD6303R::immed3() {
+	OP2 = memory[PC++]<<8;
+	OP2 |= memory[PC++];
+}
+
+void HD6303R::implied() { } 
+
+void HD6303R::index2() {
+	ADDR = IX + memory[PC++]; // Unsigned add
+	OP = memory[ADDR];
+}
+
+void HD6303R::index16() {
+	ADDR = IX + memory[PC++]; // Unsigned add
+	OP2 = getm16(ADDR);
+}
+void HD6303R::index3() { // AIM
+	OP = memory[ PC++ ];
+	ADDR = IX + memory[PC++];
+}
+
+
+// Addressing modes for decoded instructions. PC has already been advanced
+// past the instruction, and the operand bytes are passed in.
+void HD6303R::direct2(uint16_t operand) {
+	ADDR = operand;
+	OP = memory[ADDR];
+}
+
+void HD6303R::direct16(uint16_t operand) {
+	ADDR = operand;
+	OP2 = getm16(ADDR);
+}
+
+void HD6303R::direct3(uint16_t operand) { // AIM
+	OP = operand>>8;
+	ADDR = operand&0xFF;
+}
+
+void HD6303R::extend(uint16_t operand) {
+	ADDR = operand;
+	OP = memory[ADDR];
+}
+
+void HD6303R::extend16(uint16_t operand) {
+	ADDR = operand;
+	OP2 = getm16(ADDR);
+}
+
+void HD6303R::immed2(uint16_t operand) {
+	OP = operand;
+}
+
+void HD6303R::immed3(uint16_t operand) {
+	OP2 = operand;
+}
+
+void HD6303R::implied(uint16_t) { }
+
+void HD6303R::index2(uint16_t operand) {
+	ADDR = IX + operand; // Unsigned add
+	OP = memory[ADDR];
+}
+
+void HD6303R::index16(uint16_t operand) {
+	ADDR = IX + operand; // Unsigned add
+	OP2 = getm16(ADDR);
+}
+
+void HD6303R::index3(uint16_t operand) { // AIM
+	OP = operand>>8;
+	ADDR = IX + (operand&0xFF);
+}
+
+
+// Instruction bodies for a decoded operand, one specialization per opcode
+#define direct2() direct2(operand)
+#define direct16() direct16(operand)
+#define direct3() direct3(operand)
+#define extend() extend(operand)
+#define extend16() extend16(operand)
+#define immed2() immed2(operand)
+#define immed3() immed3(operand)
+#define implied() implied(operand)
+#define index2() index2(operand)
+#define index16() index16(operand)
+#define index3() index3(operand)
+#define OPCODE(op, grp, inst, am, r, w, bytes, cycles, ...) \
+	template<> inline void HD6303R::exec<op>(uint16_t operand) { __VA_ARGS__ }
+#include "HD6303R_inst.h"
+#undef OPCODE
+#undef direct2
+#undef direct16
+#undef direct3
+#undef extend
+#undef extend16
+#undef immed2
+#undef immed3
+#undef implied
+#undef index2
+#undef index16
+#undef index3
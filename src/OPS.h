@@ -18,7 +18,14 @@
 
 #pragma once
 #include <cstdint>
-#include <cmath>
+#include <cstring>
+#include <array>
+#include <utility>
+#include "OPS_tables.h"
+#include "Dispatch.h"
+#ifdef MULTI_ISA
+#include <immintrin.h>
+#endif
 
 // Struct to track a sign bit, separate from logsin value
 struct logsin_t  {
@@ -33,18 +40,13 @@ struct logsin_t  {
 struct SinTab {
 	static const int LG_N = 10;
 	static const int N = 1<<LG_N;
-	SinTab() {
-		for(int i=0; i<N; i++) {
-			table[i] = int(.5002-N*log(sin((i+.5)/N*M_PI/2))/log(2));
-		}
-	}
 	logsin_t operator()(uint32_t v) const {
 		// If bit 11 set, invert phase, then truncate
 		logsin_t s = table[ ((v&(1<<LG_N)) ? ~v : v) & (N-1) ];
 		s.sign = v&(1<<(LG_N+1)); // if bit 12 set, sign is negative
 		return s;
 	}
-	uint16_t table[N];
+	static constexpr const uint16_t *table = logsinROM; // See tabgen.cc
 };
 
 // In: 14 bit Q4.10. Out: 2^x, 14 bit (signal) or 22 bit (frequency)
@@ -52,14 +54,76 @@ struct SinTab {
 // Expanding the table to the full 14 bits shaves a few cycles
 // by precalculating the mask/shift of the int and fract parts:
 // i.e. table[x] rather than table[ x & 0x3FF ] << ((x>>10) & 0xF));
+// but it is 64K, more than the L1 cache, shared with the CPU emulation.
+// EXPTAB (USE_EXPTAB in the Makefile) selects the layout, all bit exact:
+// 0: 16K 32 bit entries (64K)
+// 1: 1K 16 bit mantissas (2K), shifted on lookup
+// 2: 16K 16 bit entries of the 14 bit output (32K), the mantissas for 22 bits
+#ifndef EXPTAB
+#define EXPTAB 0
+#endif
+// The mantissas expanded over the 4 bit integer part, keeping 22 bits,
+// downshifted (+1 entry for gathers)
+template<typename T> constexpr std::array<T, 16*1024+1> expandExp2(int down) {
+	std::array<T, 16*1024+1> table{};
+	for(int i=0; i<16*1024; i++) table[i] = ((uint32_t(exp2ROM[i&1023]) << (i>>10)) >> 5) >> down;
+	return table;
+}
 struct ExpTab {
-	ExpTab() {
-		for(int i=0; i<16*N; i++) { // Save 22 bits
-			table[i] = (uint32_t(.5+2*N*pow(2, double(i&(N-1))/N)) << ((i>>LG_N)&0xF)) >> 5;
-		}
-	}
+#if EXPTAB == 0
 	uint32_t get22(uint32_t v) const { return table[v]; }
 	uint32_t get14(uint32_t v) const { return get22(v)>>8; }
+#else
+	uint32_t get22(uint32_t v) const { return (uint32_t(mant[v&(N-1)]) << (v>>LG_N)) >> 5; }
+#if EXPTAB == 2
+	uint32_t get14(uint32_t v) const { return table[v]; }
+#else
+	uint32_t get14(uint32_t v) const { return get22(v)>>8; }
+#endif
+#endif
+
+#ifdef MULTI_ISA
+	// 8 lookups (16 bit entries are gathered as 32)
+	TARGET_AVX2 __m256i get22(__m256i v) const {
+#if EXPTAB == 0
+		return _mm256_i32gather_epi32((const int*)table.data(), v, 4);
+#else
+		__m256i m = _mm256_i32gather_epi32((const int*)mant, _mm256_and_si256(v, _mm256_set1_epi32(N-1)), 2);
+		m = _mm256_and_si256(m, _mm256_set1_epi32(0xFFFF));
+		return _mm256_srli_epi32(_mm256_sllv_epi32(m, _mm256_srli_epi32(v, LG_N)), 5);
+#endif
+	}
+	TARGET_AVX2 __m256i get14(__m256i v) const {
+#if EXPTAB == 2
+		return _mm256_and_si256(_mm256_i32gather_epi32((const int*)table.data(), v, 2), _mm256_set1_epi32(0xFFFF));
+#else
+		return _mm256_srli_epi32(get22(v), 8);
+#endif
+	}
+
+	// GCC 12.2 warns on the _mm512 intrinsics themselves (bug 105593)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+	// And 16
+	TARGET_AVX512 __m512i get22(__m512i v) const {
+#if EXPTAB == 0
+		return _mm512_i32gather_epi32(v, table.data(), 4);
+#else
+		__m512i m = _mm512_i32gather_epi32(_mm512_and_si512(v, _mm512_set1_epi32(N-1)), mant, 2);
+		m = _mm512_and_si512(m, _mm512_set1_epi32(0xFFFF));
+		return _mm512_srli_epi32(_mm512_sllv_epi32(m, _mm512_srli_epi32(v, LG_N)), 5);
+#endif
+	}
+	TARGET_AVX512 __m512i get14(__m512i v) const {
+#if EXPTAB == 2
+		return _mm512_and_si512(_mm512_i32gather_epi32(v, table.data(), 2), _mm512_set1_epi32(0xFFFF));
+#else
+		return _mm512_srli_epi32(get22(v), 8);
+#endif
+	}
+#pragma GCC diagnostic pop
+#endif
 
 	// Return full 15-bit resolution
 	int32_t invertLogSinClean(logsin_t ls) const { return ls.sign ? -get14(ls) : get14(ls); }
@@ -76,7 +140,12 @@ struct ExpTab {
 
 	static const int LG_N = 10; // 10 bit fraction
 	static const int N = 1<<LG_N; // 1024
-	uint32_t table[16*N]; // 16384 = (1<<14)
+	static constexpr const uint16_t *mant = exp2ROM; // 2^(i/N) in 1.11, see tabgen.cc
+#if EXPTAB == 0
+	static constexpr std::array<uint32_t, 16*N+1> table = expandExp2<uint32_t>(0); // 16384 = (1<<14)
+#elif EXPTAB == 2
+	static constexpr std::array<uint16_t, 16*N+1> table = expandExp2<uint16_t>(8);
+#endif
 };
 
 class OPS {
@@ -106,7 +175,7 @@ private:
 	int32_t  signal[16] = {0};
 	uint8_t  com[16] = {0};
 
-	uint16_t comtab[6] = { // log2(i+1) in 4.10 format
+	uint16_t comtab[8] = { // log2(i+1) in 4.10 format (padded to 8 for AVX2)
 		0b00000<<7, 0b01000<<7, 0b01101<<7,
 		0b10000<<7, 0b10011<<7, 0b10101<<7
 	};
@@ -139,6 +208,7 @@ public:
 				algorithm[byte1&0xF] = byte2>>3;
 				feedback[byte1&0xF] = byte2&0x7;
 			}
+			selectKernel();
 		}
 		// Ignore test modes
 	}
@@ -154,15 +224,102 @@ private:
 	uint16_t (*envelope)[16];	// envelope[6][16]
 
 	bool clean_ = false;
+	Isa isa_ = Isa::Base;
 
 public:
 	// Optionally produce full resolution output
-	void clean(bool v) { clean_ = v; }
+	void clean(bool v) { clean_ = v; selectKernel(); }
+
+	// Instruction set of the kernels
+	void isa(Isa i) { isa_ = i; selectKernel(); }
 
 	void keyOn(int n) { // Key sync resets phase
 		if(keySync) for(int i=0; i<6; i++) phase[i][n] = 0;
 	}
 
+	// Compute op for the awake voices in [from, to), one master clock cycle
+	// each. Returns the voices actually run, which may include sleeping ones
+	// sharing a SIMD group with awake ones.
+	uint16_t INLINE clock(int op, int from, int to, uint16_t awake) { return (this->*(*kernel)[op])(from, to, awake); }
+
+	// Sleeping voices (see EGS::sleep)
+	// True when running the voice with a silent envelope leaves it unchanged
+	bool quiet(int voice) const {
+		return !(modout[voice] | mren[voice] | fren1[voice] | fren2[voice] | out[order[voice]]);
+	}
+	// Advance a phase by n skipped master clock cycles at its current frequency
+	void skip(int op, int voice, uint32_t n) {
+		phase[op][voice] += n*exptab.get22(frequency[op][voice]);
+		phase[op][voice] &= (1<<23)-1;
+	}
+	// Restore the COM latched by the last op run
+	void resume(int voice, int op) { com[voice] = algoROM[algorithm[voice]][op].COM; }
+
+private:
+	// The routing of the algorithm is resolved at compile time: there is a
+	// kernel for each one, used while all voices have it (as the DX7
+	// firmware always sets them), and a generic one that looks up each
+	// voice's algorithm. So are the output mode, swapped by clean() between
+	// calls, and the instruction set (see Dispatch.h). A kernel runs one op.
+	static constexpr int Generic = 32;
+	typedef uint16_t (OPS::*Kernel)(int from, int to, uint16_t awake);
+	typedef std::array<Kernel, 6> Kernels;
+	const Kernels *kernel = &kernels[0][0][0];
+	void selectKernel() {
+		bool same = true;
+		for(int i=1; i<16; i++) same &= algorithm[i] == algorithm[0];
+		kernel = &kernels[int(isa_)][clean_][same ? algorithm[0] : Generic];
+	}
+	template<Isa isa, bool clean, int alg, int op> static constexpr Kernel opKernel() {
+#ifdef MULTI_ISA
+		if constexpr(isa == Isa::AVX512) return &OPS::opSpan16<clean, alg, op>;
+		if constexpr(isa == Isa::AVX2) return &OPS::opSpan8<clean, alg, op>;
+#endif
+		return &OPS::opSpan<clean, alg, op>;
+	}
+	template<Isa isa, bool clean, size_t... A> static constexpr std::array<Kernels, sizeof...(A)> makeKernels(std::index_sequence<A...>) {
+		return {{ Kernels{{ opKernel<isa, clean, int(A), 0>(), opKernel<isa, clean, int(A), 1>(), opKernel<isa, clean, int(A), 2>(),
+			opKernel<isa, clean, int(A), 3>(), opKernel<isa, clean, int(A), 4>(), opKernel<isa, clean, int(A), 5>() }}... }};
+	}
+	static const std::array<Kernels, Generic+1> kernels[Isas][2];
+
+	template<bool clean, int alg, int op> uint16_t opSpan(int from, int to, uint16_t awake) {
+		uint16_t ran = 0;
+		for(int v=from; v<to; v++) {
+			if(awake>>v & 1) {
+				clock<clean, alg, op>(v);
+				ran |= 1<<v;
+			}
+		}
+		return ran;
+	}
+#ifdef MULTI_ISA
+	template<bool clean, int alg, int op> TARGET_AVX2 uint16_t opSpan8(int from, int to, uint16_t awake) {
+		uint16_t ran = 0;
+		for(int v=from; v<to; v++) {
+			// A whole group is cheaper than a few voices one at a time
+			if(!(v&7) && to-v >= 8 && __builtin_popcount((awake>>v)&0xFF) > 2) {
+				clock8<clean, alg, op>(v);
+				ran |= 0xFF<<v;
+				v += 7;
+				continue;
+			}
+			if(awake>>v & 1) {
+				clock<clean, alg, op>(v);
+				ran |= 1<<v;
+			}
+		}
+		return ran;
+	}
+	template<bool clean, int alg, int op> TARGET_AVX512 uint16_t opSpan16(int from, int to, uint16_t awake) {
+		if(from == 0 && to == 16 && __builtin_popcount(awake) > 4) {
+			clock16<clean, alg, op>();
+			return 0xFFFF;
+		}
+		return opSpan8<clean, alg, op>(from, to, awake);
+	}
+#endif
+
 	// Compute one master clock cycle
 	// Note alternatively implementing an array of 16 voice objects, rather
 	// than indexing arrays of variables by voice as done here, would look
@@ -170,7 +327,7 @@ public:
 	// because of cache traffic.
 	// Marked to force inlining on GCC because it also turns out to be faster
 	// (but in general it's not such a good idea to try to outwit a compiler).
-	void INLINE clock(int op, int voice) {
+	template<bool clean, int alg, int op> void INLINE clock(int voice) {
 ////////////////////////////////////////////////////////////////////////
 ////////////////// Set up operator block ///////////////////////////////
 ////////////////////////////////////////////////////////////////////////
@@ -204,16 +361,16 @@ public:
 		logsin ^= 0x3FFF;
 
 		// Invert log, computing next signal
-		if(clean_) signal[voice] = exptab.invertLogSinClean(logsin);
+		if(clean) signal[voice] = exptab.invertLogSinClean(logsin);
 			else signal[voice] = exptab.invertLogSin(logsin);
 
-////////////////////////////////////////////////////////////////////////
-////////////////// Compute next modulation /////////////////////////////
-////////////////////////////////////////////////////////////////////////
+		modulate<alg, op>(voice);
+	}
 
-		// Get algorithm for this voice and op
-		// Could optimize out voice lookup for DX7 since all 16 are always the same
-		const algoROM_t& algo = algoROM[ algorithm[voice] ][op];
+	// Compute next modulation, from signal
+	template<int alg, int op> void INLINE modulate(int voice) {
+		// Get algorithm for this voice and op, a constant unless generic
+		const algoROM_t& algo = algoROM[ alg==Generic ? algorithm[voice] : alg ][op];
 
 		int32_t msum = 0;
 		if(algo.C) msum += mren[voice];
@@ -238,13 +395,165 @@ public:
 		// Output
 		if(op==5) out[order[voice]] = mren[voice];
 	}
+
+#ifdef MULTI_ISA
+	// 8 lanes of 32 bits, from 32, 16 and 8 bit arrays
+	static TARGET_AVX2 __m256i load(const void *p) { return _mm256_loadu_si256((const __m256i*)p); }
+	static TARGET_AVX2 __m256i load16(const void *p) { return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)p)); }
+	static TARGET_AVX2 __m256i load8(const void *p) { return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p)); }
+	static TARGET_AVX2 void store(void *p, __m256i x) { _mm256_storeu_si256((__m256i*)p, x); }
+
+	// The same as clock() for 8 voices at once, from voice (a multiple of 8),
+	// bit exact. The table lookups are gathers, and the generic kernel runs
+	// the algorithm across the lanes only if all 8 voices have the same one.
+	template<bool clean, int alg, int op> void INLINE TARGET_AVX2 clock8(int voice) {
+		const __m256i zero = _mm256_setzero_si256();
+
+		// Index and advance phase
+		__m256i phi = load(&phase[op][voice]);
+		__m256i inc = exptab.get22(load16(&frequency[op][voice]));
+		store(&phase[op][voice], _mm256_and_si256(_mm256_add_epi32(phi, inc), _mm256_set1_epi32((1<<23)-1)));
+
+		// Add modulation, and look up logsin (16 bit entries, gathered as 32)
+		phi = _mm256_add_epi32(_mm256_srli_epi32(phi, 11), load(&modout[voice]));
+		__m256i half = _mm256_set1_epi32(1<<SinTab::LG_N);
+		__m256i inv = _mm256_cmpeq_epi32(_mm256_and_si256(phi, half), half);
+		__m256i idx = _mm256_and_si256(_mm256_xor_si256(phi, inv), _mm256_set1_epi32(SinTab::N-1));
+		__m256i sign = _mm256_cmpeq_epi32(_mm256_and_si256(phi, _mm256_add_epi32(half, half)), _mm256_add_epi32(half, half));
+		__m256i logsin = _mm256_and_si256(_mm256_i32gather_epi32((const int*)sintab.table, idx, 2), _mm256_set1_epi32(0xFFFF));
+
+		// Add envelope and COM. The sum stays below 0x8000, so clamping
+		// on bit 14 is a min.
+		logsin = _mm256_add_epi32(logsin, _mm256_slli_epi32(load16(&envelope[op][voice]), 2));
+		logsin = _mm256_add_epi32(logsin, _mm256_permutevar8x32_epi32(load16(comtab), load8(&com[voice])));
+		logsin = _mm256_xor_si256(_mm256_min_epu32(logsin, _mm256_set1_epi32(0x3FFF)), _mm256_set1_epi32(0x3FFF));
+
+		// Invert log (see ExpTab::shift for the resolution loss)
+		__m256i sig = exptab.get14(logsin);
+		if(!clean) {
+			__m256i m1 = _mm256_and_si256(_mm256_cmpgt_epi32(sig, _mm256_set1_epi32(0x3FF)), _mm256_set1_epi32(1));
+			__m256i m2 = _mm256_and_si256(_mm256_cmpgt_epi32(sig, _mm256_set1_epi32(0x7FF)), _mm256_set1_epi32(2));
+			__m256i m3 = _mm256_and_si256(_mm256_cmpgt_epi32(sig, _mm256_set1_epi32(0xFFF)), _mm256_set1_epi32(4));
+			sig = _mm256_andnot_si256(_mm256_or_si256(m1, _mm256_or_si256(m2, m3)), sig);
+		}
+		sig = _mm256_sub_epi32(_mm256_xor_si256(sig, sign), sign);
+		store(&signal[voice], sig);
+
+		// Next modulation
+		if(alg == Generic) {
+			uint64_t algos;
+			memcpy(&algos, &algorithm[voice], 8);
+			if(algos != algorithm[voice] * 0x0101010101010101ull) {
+				for(int v=voice; v<voice+8; v++) modulate<alg, op>(v);
+				return;
+			}
+		}
+		const algoROM_t& algo = algoROM[ alg==Generic ? algorithm[voice] : alg ][op];
+		__m256i mr = load(&mren[voice]), f1 = load(&fren1[voice]);
+		__m256i msum = algo.C ? mr : zero;
+		if(algo.D) msum = _mm256_add_epi32(msum, sig);
+		__m256i mod = zero;
+		switch(algo.sel) {
+			case SEL0: break;
+			case SEL1: mod = sig; break;
+			case SEL2: mod = msum; break;
+			case SEL3: mod = mr; break;
+			case SEL4: mod = f1; break;
+			case SEL5: mod = _mm256_srav_epi32(_mm256_add_epi32(f1, load(&fren2[voice])),
+						_mm256_sub_epi32(_mm256_set1_epi32(8), load8(&feedback[voice]))); break;
+		}
+		store(&modout[voice], mod);
+		store(&mren[voice], msum);
+		if(algo.A) {
+			store(&fren2[voice], f1);
+			store(&fren1[voice], sig);
+		}
+		memset(&com[voice], algo.COM, 8);
+
+		// Output
+		if(op==5) for(int v=voice; v<voice+8; v++) out[order[v]] = mren[v];
+	}
+
+	// GCC 12.2 warns on the _mm512 intrinsics themselves (bug 105593)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+	// And all 16 voices
+	template<bool clean, int alg, int op> void INLINE TARGET_AVX512 clock16() {
+		const __m512i zero = _mm512_setzero_si512();
+
+		// Index and advance phase
+		__m512i phi = _mm512_loadu_si512(phase[op]);
+		__m512i inc = exptab.get22(_mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i*)frequency[op])));
+		_mm512_storeu_si512(phase[op], _mm512_and_si512(_mm512_add_epi32(phi, inc), _mm512_set1_epi32((1<<23)-1)));
+
+		// Add modulation, and look up logsin
+		phi = _mm512_add_epi32(_mm512_srli_epi32(phi, 11), _mm512_loadu_si512(modout));
+		__mmask16 inv = _mm512_test_epi32_mask(phi, _mm512_set1_epi32(1<<SinTab::LG_N));
+		__mmask16 sign = _mm512_test_epi32_mask(phi, _mm512_set1_epi32(2<<SinTab::LG_N));
+		__m512i idx = _mm512_and_si512(_mm512_mask_xor_epi32(phi, inv, phi, _mm512_set1_epi32(-1)), _mm512_set1_epi32(SinTab::N-1));
+		__m512i logsin = _mm512_and_si512(_mm512_i32gather_epi32(idx, sintab.table, 2), _mm512_set1_epi32(0xFFFF));
+
+		// Add envelope and COM, clamp and complement
+		logsin = _mm512_add_epi32(logsin, _mm512_slli_epi32(_mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i*)envelope[op])), 2));
+		__m512i coms = _mm512_cvtepu16_epi32(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)comtab)));
+		logsin = _mm512_add_epi32(logsin, _mm512_permutexvar_epi32(_mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*)com)), coms));
+		logsin = _mm512_xor_si512(_mm512_min_epu32(logsin, _mm512_set1_epi32(0x3FFF)), _mm512_set1_epi32(0x3FFF));
+
+		// Invert log
+		__m512i sig = exptab.get14(logsin);
+		if(!clean) {
+			__m512i m = _mm512_maskz_mov_epi32(_mm512_cmpgt_epi32_mask(sig, _mm512_set1_epi32(0x3FF)), _mm512_set1_epi32(1));
+			m = _mm512_mask_mov_epi32(m, _mm512_cmpgt_epi32_mask(sig, _mm512_set1_epi32(0x7FF)), _mm512_set1_epi32(3));
+			m = _mm512_mask_mov_epi32(m, _mm512_cmpgt_epi32_mask(sig, _mm512_set1_epi32(0xFFF)), _mm512_set1_epi32(7));
+			sig = _mm512_andnot_si512(m, sig);
+		}
+		sig = _mm512_mask_sub_epi32(sig, sign, zero, sig);
+		_mm512_storeu_si512(signal, sig);
+
+		// Next modulation
+		if(alg == Generic) {
+			uint64_t algos[2];
+			memcpy(algos, algorithm, 16);
+			if(algos[0] != algorithm[0] * 0x0101010101010101ull || algos[1] != algos[0]) {
+				for(int v=0; v<16; v++) modulate<alg, op>(v);
+				return;
+			}
+		}
+		const algoROM_t& algo = algoROM[ alg==Generic ? algorithm[0] : alg ][op];
+		__m512i mr = _mm512_loadu_si512(mren), f1 = _mm512_loadu_si512(fren1);
+		__m512i msum = algo.C ? mr : zero;
+		if(algo.D) msum = _mm512_add_epi32(msum, sig);
+		__m512i mod = zero;
+		switch(algo.sel) {
+			case SEL0: break;
+			case SEL1: mod = sig; break;
+			case SEL2: mod = msum; break;
+			case SEL3: mod = mr; break;
+			case SEL4: mod = f1; break;
+			case SEL5: mod = _mm512_srav_epi32(_mm512_add_epi32(f1, _mm512_loadu_si512(fren2)),
+						_mm512_sub_epi32(_mm512_set1_epi32(8), _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*)feedback)))); break;
+		}
+		_mm512_storeu_si512(modout, mod);
+		_mm512_storeu_si512(mren, msum);
+		if(algo.A) {
+			_mm512_storeu_si512(fren2, f1);
+			_mm512_storeu_si512(fren1, sig);
+		}
+		memset(com, algo.COM, 16);
+
+		// Output
+		if(op==5) _mm512_i32scatter_epi32(out, _mm512_loadu_si512(order), msum, 4);
+	}
+#pragma GCC diagnostic pop
+#endif
 };
 
 inline const SinTab OPS::sintab;
 inline const ExpTab OPS::exptab;
 
 // Algorithm ROM definitions
-inline const OPS::algoROM_t OPS::algoROM[32][6] = {
+inline constexpr const OPS::algoROM_t OPS::algoROM[32][6] = {
 // Signals: { SEL, A, C, D, COM }
 //	OP:     6               5               4               3               2               1
 	{{SEL1,1,0,0,0}, {SEL1,0,0,0,0}, {SEL1,0,0,0,1}, {SEL0,0,0,1,0}, {SEL1,0,1,0,1}, {SEL5,0,1,1,0}}, // 1 
@@ -281,3 +590,13 @@ inline const OPS::algoROM_t OPS::algoROM[32][6] = {
 	{{SEL0,1,0,1,5}, {SEL0,0,1,1,5}, {SEL0,0,1,1,5}, {SEL0,0,1,1,5}, {SEL0,0,1,1,5}, {SEL5,0,1,1,5}}, // 32 
 };
 
+inline const std::array<OPS::Kernels, OPS::Generic+1> OPS::kernels[Isas][2] = {
+	{ OPS::makeKernels<Isa::Base, false>(std::make_index_sequence<OPS::Generic+1>()),
+	  OPS::makeKernels<Isa::Base, true>(std::make_index_sequence<OPS::Generic+1>()) },
+#ifdef MULTI_ISA
+	{ OPS::makeKernels<Isa::AVX2, false>(std::make_index_sequence<OPS::Generic+1>()),
+	  OPS::makeKernels<Isa::AVX2, true>(std::make_index_sequence<OPS::Generic+1>()) },
+	{ OPS::makeKernels<Isa::AVX512, false>(std::make_index_sequence<OPS::Generic+1>()),
+	  OPS::makeKernels<Isa::AVX512, true>(std::make_index_sequence<OPS::Generic+1>()) },
+#endif
+};
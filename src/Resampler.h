@@ -0,0 +1,208 @@
+/**
+ *  VDX7 - Virtual DX7 synthesizer emulation
+ *  Copyright (C) 2023  chiaccona@gmail.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+**/
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "Dispatch.h"
+
+// Polyphase FIR sample rate converter
+//
+// Converts from inRate to outRate with a Kaiser windowed sinc lowpass,
+// convolved with the impulse response of a filter ahead of it (pre), so
+// that the two run as one FIR. The kernel is tabulated at a number of
+// phases per input sample, and each output interpolates linearly between
+// the two phases either side of it. DX7Synth uses it to go from the
+// native rate to the host rate, and for the fused output stage (see
+// DX7Synth::fuse) from the 16 subsamples per sample of the OPS straight to
+// the host rate, with the S-K decimation filter as pre.
+//
+// There are three quality tiers, all designed up front so that switching
+// between them (e.g. from the LV2 port) doesn't allocate.
+class Resampler {
+public:
+	struct Tier {
+		const char *name;
+		double attenuation; // dB
+		// Passband, at most this fraction of the lower of the two rates.
+		// The stopband starts where it would alias onto it.
+		double passband, maxPassband;
+		double tableRate; // Of the tabulated kernel, at least (Hz)
+	};
+	static constexpr int Tiers = 3;
+	static constexpr Tier tiers[Tiers] = {
+		{ "fast", 80, 20000, 0.4167, 3e6 },
+		{ "medium", 100, 20000, 0.4167, 12.5e6 },
+		{ "best", 120, 21000, 0.45, 50e6 },
+	};
+	// Tier by name, -1 if none
+	static int tier(const char *name) {
+		for(int t=0; t<Tiers; t++) if(!strcmp(name, tiers[t].name)) return t;
+		return -1;
+	}
+
+	// Kernels with pre, and without (see bypass()), for every tier.
+	// Allocates, so not in the audio thread. maxIn is the most input
+	// committed at once, and maxOut the most output read.
+	void design(double inRate, double outRate, const std::vector<double> &pre, int maxIn, int maxOut) {
+		double base = std::min(inRate, outRate);
+		history = 0;
+		for(int t=0; t<Tiers; t++) {
+			const Tier &tier = tiers[t];
+			double pass = std::min(tier.passband, tier.maxPassband*base);
+			double fc = base/2/inRate; // Cutoff, cycles per input sample
+			double width = (base - 2*pass)/inRate; // Transition
+			int n = int(std::ceil((tier.attenuation - 7.95)/(2.285*2*M_PI*width))) + 1;
+			double beta = 0.1102*(tier.attenuation - 8.7);
+			int bits = 0;
+			while(inRate*(1<<bits) < tier.tableRate) bits++;
+			const int phases = 1<<bits;
+
+			// The lowpass at every phase
+			std::vector<double> g(n*phases);
+			double mid = (n-1)/2.0;
+			for(int q=0; q<n*phases; q++) {
+				double x = double(q)/phases - mid, r = x/mid;
+				double sinc = x == 0 ? 2*fc : std::sin(2*M_PI*fc*x)/(M_PI*x);
+				g[q] = r*r < 1 ? sinc*bessel(beta*std::sqrt(1 - r*r))/bessel(beta) : 0;
+			}
+			for(int b=0; b<2; b++) {
+				Kernel &kern = kernel[t][b];
+				kern.phaseBits = bits;
+				tabulate(kern, g, n, b ? std::vector<double>{1.0} : pre);
+				history = std::max(history, kern.taps);
+			}
+		}
+
+		// Short of input for maxOut outputs, there are fewer than
+		// maxOut*inRate/outRate samples unread, and then maxIn more
+		buf.assign(history + maxIn + int(std::ceil(maxOut*inRate/outRate)) + 1, 0);
+		filled = history - 1;
+		pos = uint64_t(filled)<<32;
+		step = uint64_t(std::llround(inRate/outRate*4294967296.0));
+		this->maxIn = maxIn;
+		avx2 = cpuIsa() != Isa::Base;
+	}
+	void bypass(bool v) { bypassed = v; k = &kernel[tier_][bypassed]; } // The pre filter
+	void quality(int t) { tier_ = t; k = &kernel[tier_][bypassed]; }
+	int quality() const { return tier_; }
+	bool designed() const { return !buf.empty(); }
+
+	// Write up to maxIn samples at input(), then commit() them. Only while
+	// not ready() for at most maxOut, which design() left room for.
+	float *input() {
+		if(filled + maxIn > int(buf.size())) { // Drop what is no longer needed
+			int drop = int(pos>>32) - (history-1);
+			memmove(buf.data(), buf.data() + drop, (filled - drop)*sizeof(float));
+			filled -= drop;
+			pos -= uint64_t(drop)<<32;
+			assert(filled + maxIn <= int(buf.size()));
+		}
+		return buf.data() + filled;
+	}
+	void commit(int n) { filled += n; }
+
+	// There is the input for n outputs
+	bool ready(int n) const { return (pos + (n-1)*step)>>32 < uint64_t(filled); }
+	void read(float *out, int n) {
+#ifdef MULTI_ISA
+		if(avx2) { readAVX2(out, n); return; }
+#endif
+		convolve(out, n);
+	}
+
+private:
+	struct Kernel {
+		int taps = 0, phaseBits = 0;
+		std::vector<float> table; // 2^phaseBits+1 rows of taps, latest input last
+	};
+	Kernel kernel[Tiers][2], *k = &kernel[1][0];
+	int tier_ = 1;
+	bool bypassed = false, avx2 = false;
+	std::vector<float> buf; // Input, with history for the kernel
+	int filled = 0, history = 0, maxIn = 0;
+	uint64_t pos = 0, step = 0; // 32.32 input samples: of the next output, and between them
+
+	// Eight lanes whatever the instruction set, summed in a fixed order
+	// with vector adds (-ffast-math reassociates scalar ones), so that the
+	// AVX2 variant is bit exact with SSE2 (cf. Filter)
+	typedef float Lanes __attribute__((vector_size(32), aligned(4)));
+	static inline __attribute__((always_inline)) float sum(const Lanes &a) {
+		Lanes b = a + __builtin_shufflevector(a, a, 4, 5, 6, 7, 0, 1, 2, 3);
+		b += __builtin_shufflevector(b, b, 2, 3, 0, 1, 6, 7, 4, 5);
+		b += __builtin_shufflevector(b, b, 1, 0, 3, 2, 5, 4, 7, 6);
+		return b[0];
+	}
+	inline __attribute__((always_inline)) void convolve(float *out, int n) {
+		const int taps = k->taps, bits = k->phaseBits;
+		for(int j=0; j<n; j++, pos += step) {
+			const float *x = buf.data() + (pos>>32) - (taps-1);
+			uint32_t frac = uint32_t(pos);
+			const float *c0 = k->table.data() + size_t(frac>>(32-bits))*taps, *c1 = c0 + taps;
+			Lanes a0 = {}, a1 = {};
+			for(int i=0; i<taps; i+=8) {
+				Lanes xi = *(const Lanes*)(x+i);
+				a0 += *(const Lanes*)(c0+i)*xi;
+				a1 += *(const Lanes*)(c1+i)*xi;
+			}
+			float s0 = sum(a0), s1 = sum(a1);
+			float w = uint32_t(frac<<bits)*(1.0f/4294967296.0f);
+			out[j] = s0 + w*(s1 - s0);
+		}
+	}
+#ifdef MULTI_ISA
+	TARGET_AVX2 void readAVX2(float *out, int n) { convolve(out, n); }
+#endif
+
+	// Modified Bessel function I0
+	static double bessel(double x) {
+		double sum = 1, term = 1;
+		for(int i=1; term > 1e-12*sum; i++) {
+			term *= (x/(2*i))*(x/(2*i));
+			sum += term;
+		}
+		return sum;
+	}
+
+	// The lowpass g (n taps at each phase) convolved with pre
+	static void tabulate(Kernel &kern, const std::vector<double> &g, int n, const std::vector<double> &pre) {
+		const int phases = 1<<kern.phaseBits;
+		int len = n + int(pre.size());
+		kern.taps = (len + 7) & ~7; // Whole vectors
+		kern.table.assign((phases+1)*kern.taps, 0);
+		std::vector<double> c(kern.taps);
+		for(int p=0; p<=phases; p++) {
+			float *row = kern.table.data() + p*kern.taps;
+			double sum = 0;
+			for(int i=0; i<kern.taps; i++) { // At i+p/phases after the input
+				c[i] = 0;
+				for(int m=0; m<int(pre.size()) && m<=i; m++) {
+					int q = (i-m)*phases + p;
+					if(q < n*phases) c[i] += pre[m]*g[q];
+				}
+				sum += c[i];
+			}
+			for(int i=0; i<kern.taps; i++) row[kern.taps-1-i] = c[i]/sum; // Unity gain at DC
+		}
+	}
+};
@@ -19,20 +19,21 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cmath>
+#include <cstring>
 #include <unistd.h>
+#include <pthread.h>
 
 #include "Synth.h"
 
 DX7Synth::DX7Synth(const char* rf) : dx7(toSynth, toGui, rf) {
 
 	setMidiVelocity(0.4);
+	dx7.egs.runAhead(true);
 
-	// Set up libsamplerate converter callback
+	// Set up libsamplerate converter callback, for setQuality(Libsamplerate)
 	int error;
 	if (!(src_state = src_callback_new(
 			DX7Synth::fillCallback,
-			// FIX make this selectable
-			//SRC_SINC_MEDIUM_QUALITY, 1,
 			SRC_SINC_FASTEST, 1,
 			&error,
 			(void*)this))) {
@@ -49,6 +50,15 @@ fprintf(stderr, "Sample Rate = %.0f\n", fs);
 	cpuCyclesPerBuf = BufSize * (((9.4265e6  / 2) / 4) / FS);
 	fprintf(stderr, "cpuCyclesPerBuf = %f\n", cpuCyclesPerBuf);
 	dx7.midiFilter.set_f(10.6/fs);
+	// The S-K filter's response down to -80dB
+	if(fused) resampler.design(16*49096.0, FS, Filter::response(1e-4), 16*2*BufSize, BufSize);
+	else resampler.design(49096.0, FS, {1.0}, 2*BufSize, BufSize);
+}
+
+void DX7Synth::setQuality(int q) {
+	if(q < 0 || q > Libsamplerate) return;
+	quality = q;
+	if(q < Resampler::Tiers) resampler.quality(q);
 }
 
 // Process event messages, handing off to CPU
@@ -122,7 +132,7 @@ void DX7Synth::processMessage(Message msg) {
 //fprintf(stderr, "msg: %02X(%d) %02X(%d)\n", msg.byte1, msg.byte1, msg.byte2, msg.byte2);
 }
 
-int DX7Synth::fillBuffer() {
+int DX7Synth::fillBuffer(float *out) {
 	// Sync DX7 CPU clock to Jack sampling rate
 	// cpuCyclesPerBuf := BufSize * (((9.4265Mhz / 2) / 4) / SampleRate) 
 	// E.g. for 48khz and 128byte buffer, run for minimum 3142 cycles
@@ -132,33 +142,113 @@ int DX7Synth::fillBuffer() {
 	// Native DX7 SR is 49,096.354 samp/sec (9.4265e6/2/4)*(2/3)/16
 	// So 130.9236 samples would be generated per 128 sample Jack buffer,
 	// hence need to rate adapt to match Jack sample rate
+	// With run-ahead (the default, see EGS::runAhead), the EGS and OPS are
+	// rendered once the CPU has run the whole block, rather than after
+	// each instruction.
 	cyc_count += cpuCyclesPerBuf;
 	int outCnt = 0;
 	Message msg;
 	while(cyc_count > 0) {
 		// Process messages
+		bool popped = false;
 		if(!dx7.haveMsg) // CPU is ready
-			if(toSynth->pop(msg)) processMessage(msg);
-
-		// Run one instruction
+			if((popped = toSynth->pop(msg))) processMessage(msg);
+
+		// Samples in the buffer, counting those still to be rendered
+		if(dx7.egs.logFull()) render(out, outCnt, false);
+		int count = outCnt + dx7.egs.lagging();
+
+		// Run one instruction. The CPU may run ahead of it for fewer than
+		// fuseLimit cycles if that can't change anything here: no message
+		// to pop, and still room in the buffer (one sample per 24 cycles).
+		// See HD6303R::stepFused.
+		if(popped && !dx7.haveMsg) dx7.fuseLimit = 0;
+		else dx7.fuseLimit = std::min(int(std::ceil(cyc_count)), 24*(2*BufSize-2-count));
 		dx7.run();
 
 		// Clock the EGS and OPS. Each CPU cycle is 4 master clock ticks
 		// FIX BufSize
-		if(outCnt<2*BufSize) dx7.egs.clock(buffer, outCnt, 4*dx7.inst->cycles);
+		if(count<2*BufSize) dx7.egs.clock(out, outCnt, 4*dx7.inst->cycles);
 
 		cyc_count -= dx7.inst->cycles;
 	}
-	return outCnt; 
+	render(out, outCnt, true);
+	if(!pipelined()) return outCnt;
+
+	// Return the block before
+	if(!primed) { // Silence for the first
+		memset(out, 0, outCnt*dx7.egs.stride()*sizeof(float));
+		primed = true;
+		// Run the DSP thread like this one
+		int policy;
+		sched_param param;
+		if(pthread_getschedparam(pthread_self(), &policy, &param) ||
+			pthread_setschedparam(dsp.native_handle(), policy, &param))
+				fprintf(stderr, "Can't set the DSP thread's priority\n");
+		return outCnt;
+	}
+	while(!rendered.pop(outCnt)) std::this_thread::yield(); // DSP thread is behind
+	memcpy(out, dspBuffer[dspSlot], outCnt*dx7.egs.stride()*sizeof(float));
+	dspSlot ^= 1;
+	return outCnt;
+}
+
+void DX7Synth::render(float *out, int &outCnt, bool last) {
+	if(!pipelined()) {
+		dx7.egs.render(out, outCnt);
+		return;
+	}
+	EGS::Batch *next;
+	while(!unused.pop(next)) std::this_thread::yield(); // DSP thread is behind
+	EGS::Batch *b = dx7.egs.handOff(next, outCnt);
+	b->last = last;
+	logged.push(b);
+	sem_post(&dspWake);
+}
+
+void DX7Synth::pipeline(bool on) {
+	if(on == pipelined()) return;
+	if(on) {
+		for(auto &b : batches) unused.push(&b);
+		sem_init(&dspWake, 0, 0);
+		primed = false;
+		dspSlot = 0;
+		dsp = std::thread(&DX7Synth::dspRun, this);
+	} else {
+		sem_post(&dspWake); // With nothing to render
+		dsp.join();
+		sem_destroy(&dspWake);
+	}
+}
+
+void DX7Synth::dspRun() {
+	int slot = 0, count = 0;
+	EGS::Batch *b;
+	for(;;) {
+		if(sem_wait(&dspWake)) continue; // Interrupted
+		if(!logged.pop(b)) break;
+		dx7.egs.render(*b, dspBuffer[slot], count);
+		if(b->last) {
+			rendered.push(count);
+			slot ^= 1;
+			count = 0;
+		}
+		unused.push(b);
+	}
 }
 
 // Produces one BufSize buffer of output
 void DX7Synth::run() {
 	// Audio
-	int rc = src_callback_read(src_state, ratio, BufSize, outputBuffer);
-	if (rc < BufSize) {
-		fprintf(stderr, "src_callback_read: short output (%d != %d)\n", rc, BufSize);
-		return;
+	if(fused || quality != Libsamplerate) {
+		while(!resampler.ready(BufSize)) resampler.commit(dx7.egs.stride()*fillBuffer(resampler.input()));
+		resampler.read(outputBuffer, BufSize);
+	} else {
+		int rc = src_callback_read(src_state, ratio, BufSize, outputBuffer);
+		if (rc < BufSize) {
+			fprintf(stderr, "src_callback_read: short output (%d != %d)\n", rc, BufSize);
+			return;
+		}
 	}
 
 	// MIDI volume is filtered in hardware by a 10hz lowpass smoother,
@@ -218,7 +308,7 @@ bool DX7Synth::parseMIDI(const uint32_t size, const uint8_t *const buffer) {
 				return false; // also forward to serial
 
 		// Turn on "clean" mode (no modelling of DX7 DAC)
-		case 98: dx7.egs.clean(buffer[2]); printf("clean=%d\n", bool(buffer[2])); return true;
+		case 98: dx7.egs.clean(buffer[2]); resampler.bypass(buffer[2]); printf("clean=%d\n", bool(buffer[2])); return true;
 
 		// Otherwise pass controller on to serial interface
 		default: return false;
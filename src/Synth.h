@@ -20,9 +20,13 @@
 
 #include <cstdio>
 #include <cstdint>
+#include <thread>
+#include <semaphore.h>
 #include <samplerate.h>
 
 #include "Message.h"
+#include "LFQ.h"
+#include "Resampler.h"
 #include "dx7.h"
 
 class Synth {
@@ -45,7 +49,7 @@ public:
 class DX7Synth : public Synth {
 public:
 	DX7Synth(const char* rf=0);
-	virtual ~DX7Synth() { }
+	virtual ~DX7Synth() { pipeline(false); }
 
 	DX7 dx7; // The hardware emulator
 
@@ -60,7 +64,8 @@ public:
 	// Audio buffer output from DX7 at native SR
 	// FIX size this properly, 2x "should be" enough
 	float buffer[2*BufSize] = {0};
-	int fillBuffer(); // DX7 audio generator
+	int fillBuffer(float *out); // DX7 audio generator
+	void render(float *out, int &outCnt, bool last); // Render the EGS log, or pass it on
 	void processMessage(Message msg); // Hand off events to DX7 CPU
 	SRC_STATE *src_state; // libsamplerate state variable
 
@@ -99,11 +104,49 @@ public:
 	uint8_t midibuf[maxSysex];
 	uint32_t size = 0; // track midi msg size
 
+	// Pipeline
+	// Optionally the EGS and OPS render on a second thread, one block
+	// behind the CPU: fillBuffer() hands the EGS's log over to it in
+	// batches, and returns the block before, which it has rendered
+	// meanwhile. Adds one block of latency. Switch it on before start(),
+	// and off only on exit.
+	void pipeline(bool on);
+	bool pipelined() const { return dsp.joinable(); }
+	void dspRun(); // The DSP thread
+	static constexpr int Batches = 8;
+	EGS::Batch batches[Batches];
+	CircularFifo<EGS::Batch*, Batches> logged, unused; // To render, and free
+	CircularFifo<int, 2> rendered; // Samples in the blocks rendered
+	float dspBuffer[2][16*2*BufSize];
+	int dspSlot = 0; // Of the next block rendered
+	bool primed = false; // A block has been handed over
+	std::thread dsp;
+	sem_t dspWake; // Posted for each batch handed over
+
+	// Fused output stage
+	// Optionally the EGS outputs the 16 voices of each sample unfiltered,
+	// and a single polyphase FIR, with the S-K filter's response folded
+	// in, takes them straight to the host rate, in place of the S-K
+	// filter, decimation and resampling. There is then no aliasing at
+	// the native rate. Switch it on before setSampleRate().
+	void fuse(bool on) { fused = on; dx7.egs.subsamples(on); }
+	bool fused = false;
+
+	// Resampling to the host rate
+	// The built-in resampler (Resampler.h) at one of its quality tiers, or
+	// libsamplerate (SRC_SINC_FASTEST). The fused stage is always built-in.
+	// The tiers are all designed by setSampleRate(), so this can be called
+	// from the audio thread, though switching may click.
+	static constexpr int Libsamplerate = Resampler::Tiers;
+	void setQuality(int q);
+	int quality = 1; // medium
+	Resampler resampler;
+
 	// Callback for libsamplerate
 	static long fillCallback(void *cb_data, float **audio) {
 		DX7Synth *me = (DX7Synth*)cb_data;
 		*audio = me->buffer;
-		return me->fillBuffer();
+		return me->fillBuffer(me->buffer);
 	}
 };
 
@@ -0,0 +1,108 @@
+/**
+ *  VDX7 - Virtual DX7 synthesizer emulation
+ *  Copyright (C) 2023  chiaccona@gmail.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+**/
+
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include "LFQ.h"
+
+// Binary instruction trace
+//
+// The CPU pushes a fixed size record per instruction into a lock-free ring
+// (see HD6303R::step), and a non real time thread drains it to a file,
+// which tracedump.cc decodes. Records are never waited for: if the ring
+// is full they are dropped, and the next one records how many were.
+
+// A trace file is the magic followed by the records, in host byte order
+static constexpr char TraceMagic[8] = {'V','D','X','7','T','R','C','1'};
+
+struct TraceRecord {
+	uint64_t cycle; // Before the instruction
+	uint16_t pc, operand; // Instruction address, and the two bytes after the opcode
+	uint16_t addr; // Memory accessed, 0 if none
+	uint16_t ix, sp; // Registers after the instruction (and any interrupt it let in)
+	uint8_t opcode, a, b, ccr;
+	uint16_t dropped; // Records lost just before this one (saturates)
+};
+static_assert(sizeof(TraceRecord) == 24, "TraceRecord is a file format");
+
+class Tracer {
+public:
+	~Tracer() { stop(); }
+
+	// Open the file and start draining the ring to it
+	int start(const char *f) {
+		fp = fopen(f, "w");
+		if(!fp) return(-1);
+		if(fwrite(TraceMagic, sizeof(TraceMagic), 1, fp) != 1) {
+			fclose(fp);
+			fp = 0;
+			return(-2);
+		}
+		running = true;
+		thread = std::thread(&Tracer::drain, this);
+		return(0);
+	}
+
+	// Write out what is left in the ring and close the file
+	void stop() {
+		if(!fp) return;
+		running = false;
+		thread.join();
+		fclose(fp);
+		fp = 0;
+	}
+
+	// Called by the CPU, never blocks
+	void record(TraceRecord &r) {
+		r.dropped = dropped;
+		if(ring.push(r)) dropped = 0;
+		else if(dropped < 0xFFFF) dropped++;
+	}
+
+private:
+	static constexpr int Batch = 1024;
+
+	void drain() {
+		TraceRecord buf[Batch];
+		for(;;) {
+			bool last = !running; // Still drain what's left once stopped
+			int n = 0;
+			while(n < Batch && ring.pop(buf[n])) n++;
+			if(n && fwrite(buf, sizeof(TraceRecord), n, fp) != size_t(n)) {
+				fprintf(stderr, "Trace write failed\n");
+				return;
+			}
+			if(n < Batch) {
+				if(last) return;
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+	}
+
+	CircularFifo<TraceRecord, 1<<16> ring;
+	uint16_t dropped = 0;
+	std::atomic<bool> running{false};
+	std::thread thread;
+	FILE *fp = 0;
+};
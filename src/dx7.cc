@@ -23,7 +23,14 @@ DX7::DX7(ToSynth*& ts, ToGui*& tg, const char *rf)
 	// Load ROM
 	const uint8_t *rom = _binary_firmware_bin_start;
 	for(int addr = 0xC000; addr<0x10000; addr++) memory[addr] = *rom++;
+	native = nativeROM();
+	hleInstall();
 	cartFile.reserve(256); // avoid runtime std::string allocation
+
+	// Memory mapped devices, called by step() after a write
+	writeHook[0x28] = static_cast<WriteHook>(&DX7::peripheralWrite);
+	writeHook[0x30] = static_cast<WriteHook>(&DX7::egsWrite);
+	for(int p=0x40; p<0x50; p++) writeHook[p] = static_cast<WriteHook>(&DX7::cartWrite);
 }
 
 // Load a firmware ROM
@@ -52,6 +59,9 @@ int DX7::loadROM(const char *romfile) {
 		return(-3);
 	}
 	fclose(fp);
+	invalidate(0xC000, 0xFFFF);
+	native = nativeROM(); // Unless it's a custom ROM
+	hleInstall(); // Likewise
 	return(0);
 }
 
@@ -101,6 +111,12 @@ DX7::~DX7() {
 		if(err) fprintf(stderr, "Can't save cartridge (%d)\n", err);
 			else fprintf(stderr, "Saved cartridge (%s)\n", cartFile.c_str());
 	}
+
+#ifdef PROFILE
+	err = profileDump("vdx7.prof");
+	if(err) fprintf(stderr, "Can't save profile (%d)\n", err);
+		else fprintf(stderr, "Saved profile (vdx7.prof)\n");
+#endif
 }
 
 void DX7::tune(int tuning) {
@@ -113,18 +129,23 @@ void DX7::tune(int tuning) {
 }
 
 void DX7::run() {
+	// Fused instructions must not step over the handshake or a baud tick below
+	if(haveMsg && !byte1Sent && bit(PORT2,0)) fuseLimit = 0;
+	if(!bit(TRCSR,TDRE) && bit(TRCSR,TE)) fuseLimit = std::min<int64_t>(fuseLimit, std::max<int64_t>(sci_tx_start+377-cycle, 0));
+	if(!midiSerialRx.empty() && !bit(TRCSR,RDRF)) fuseLimit = std::min<int64_t>(fuseLimit, std::max<int64_t>(sci_rx_start+377-cycle, 0));
 	step();
+	fuseLimit = 0;
 
-	// Serial baud rate timer.
+	// Serial baud rate timer, only of interest with a byte to send or receive.
 	// Hardware actually uses an external clock to get the MIDI 31.25k baud rate
-	if(sci_tx_counter>=377) { // 377 = ((9.4265Mhz/2)/4) / 3125;  31.25k baud = 3125 bytes/sec
+	if(!bit(TRCSR,TDRE) && cycle-sci_tx_start>=377) { // 377 = ((9.4265Mhz/2)/4) / 3125;  31.25k baud = 3125 bytes/sec
 		// Serial TX -  get the transmitted byte from CPU and save to a buffer to transmit 
 		uint8_t byte;
 		if(clockOutData(byte)) midiSerialTx.write(byte);
 	}
-	if(sci_rx_counter>=377) { // 31.25k baud
+	if(!midiSerialRx.empty() && cycle-sci_rx_start>=377) { // 31.25k baud
 		// Serial RX - if data available in RX buffer, wait for RDRF to clear, then send to CPU
-		if(!midiSerialRx.empty() && bit(TRCSR,RDRF)==0) clockInData(midiSerialRx.read());
+		if(bit(TRCSR,RDRF)==0) clockInData(midiSerialRx.read());
 	}
 
 	// Should not happen (debug guard)
@@ -133,74 +154,65 @@ void DX7::run() {
 	// Start of sub-CPU Event Handshake:
 	// P20/C2 high means main CPU is ready for next message
 	// haveMsg means Synth/GUI has given us a message to process
-	if(bit(PORT2,0) && haveMsg && !byte1Sent) {
+	if(haveMsg && !byte1Sent && bit(PORT2,0)) {
 		PORT1 = msg.byte1;
 		clear(PORT2,1); // Sub-CPU clears pin 21, telling CPU to read in the byte
 		irqpin = false; // Active low triggers IRQ interrupt
+		nextEvent = 0;
 		byte1Sent = true;
 	}
+}
 
-	// Only need to look at instructions that write memory from here on
-	if(inst->w == false) return;
-
-	// Writing to peripheral controller 0x280*
-	if((ADDR&0xFFF0)==0x2800) {
-
-		if(ADDR==0x2800) { // P_LCD_DATA
-			// FIX keeping these in both DSP and GUI
-			if(memory[0x2801]==4) {
-				toGui->lcd_inst(memory[ADDR]);
-				lcd.inst(memory[ADDR]);
-			}
-			else if(memory[0x2801]==5) {
-				toGui->lcd_data(memory[ADDR]);
-				lcd.data(memory[ADDR]);
-			}
-		}
-		
-		else if(ADDR==0x2801) { // P_LCD_CTRL
-			// can ignore - always Written before P_LCD_DATA
-		}
-
-		else if(ADDR==0x280C) { // &P_ACEPT
-			// Completion of sub-CPU Event Handshake
-			// After HANDLER_IRQ interrupt has run for a while...
-			// P_ACEPT flipflop is set by hardware when 0x280C is put on the system bus,
-			// driving C1 low on the Sub-CPU, telling us we can send the second byte
-			if(byte1Sent) {
-				PORT1 = msg.byte2;
-				clear(PORT2,1); // Sub-CPU signals to read in the second byte
-				irqpin = false; // Hardware also activates IRQ, but it's now masked
-				byte1Sent = false;
-			} else { // We're done
-				irqpin = true; // P_ACEPT resets IRQ READY flipflop
-				haveMsg = false; // Tell Synth/GUI we're ready for another message
-			}
+// Writing to peripheral controller 0x280*
+void DX7::peripheralWrite(uint16_t addr) {
+	if(addr==0x2800) { // P_LCD_DATA
+		// FIX keeping these in both DSP and GUI
+		if(memory[0x2801]==4) {
+			toGui->lcd_inst(memory[addr]);
+			lcd.inst(memory[addr]);
 		}
-
-		else if(ADDR==0x280E) { // P_LED1 & P_LED2
-			// LED update, writes to these addresses propagate to LED controller
-			// CPU always writes 0x280F before 0x280E
-			toGui->led1_setval(P_LED1);
-			toGui->led2_setval(P_LED2);
+		else if(memory[0x2801]==5) {
+			toGui->lcd_data(memory[addr]);
+			lcd.data(memory[addr]);
 		}
+	}
+	
+	else if(addr==0x2801) { // P_LCD_CTRL
+		// can ignore - always Written before P_LCD_DATA
+	}
 
-		else if(ADDR==0x2805) { // P_OPS_MODE & P_OPS_ALG_FDBK
-			// Algorithm update. Firmware always writes 0x2804 before 0x2805
-			egs.setAlgorithm(P_OPS_MODE, P_OPS_ALG_FDBK);
+	else if(addr==0x280C) { // &P_ACEPT
+		// Completion of sub-CPU Event Handshake
+		// After HANDLER_IRQ interrupt has run for a while...
+		// P_ACEPT flipflop is set by hardware when 0x280C is put on the system bus,
+		// driving C1 low on the Sub-CPU, telling us we can send the second byte
+		if(byte1Sent) {
+			PORT1 = msg.byte2;
+			clear(PORT2,1); // Sub-CPU signals to read in the second byte
+			irqpin = false; // Hardware also activates IRQ, but it's now masked
+			nextEvent = 0;
+			byte1Sent = false;
+		} else { // We're done
+			irqpin = true; // P_ACEPT resets IRQ READY flipflop
+			haveMsg = false; // Tell Synth/GUI we're ready for another message
 		}
+	}
 
-		else if(ADDR==0x280A) { // P_DAC - MIDI volume control
-			midiVolume = P_DAC&7;
-		}
+	else if(addr==0x280E) { // P_LED1 & P_LED2
+		// LED update, writes to these addresses propagate to LED controller
+		// CPU always writes 0x280F before 0x280E
+		toGui->led1_setval(P_LED1);
+		toGui->led2_setval(P_LED2);
 	}
 
-	// Writing to EGS address space 0x30**
-	// Trigger EGS to update internal pitch registers
-	if((ADDR&0xFF00)==0x3000) egs.update(uint8_t(ADDR));
+	else if(addr==0x2805) { // P_OPS_MODE & P_OPS_ALG_FDBK
+		// Algorithm update. Firmware always writes 0x2804 before 0x2805
+		egs.setAlgorithm(P_OPS_MODE, P_OPS_ALG_FDBK);
+	}
 
-	// Writing to Cartidge 0x4***, flag to save it on exit
-	if((ADDR&0xF000)==0x4000) saveCart = true;
+	else if(addr==0x280A) { // P_DAC - MIDI volume control
+		midiVolume = P_DAC&7;
+	}
 }
 
 // Load a cartridge from a SYSEX formatted file
@@ -19,6 +19,7 @@
 #pragma once
 
 #include <cstring>
+#include <algorithm>
 #include <string>
 #include <map>
 #include "HD6303R.h"
@@ -65,6 +66,11 @@ struct DX7: public HD6303R {
 	void start();
 	void run(); // Execute one instruction and update peripherals
 
+	// Write hooks for the memory mapped devices
+	void peripheralWrite(uint16_t addr); // 0x28**, only 0x280* used
+	void egsWrite(uint16_t addr) { egs.write(uint8_t(addr), memory[addr], memory[uint16_t(addr+1)]); } // 0x30**, EGS updates pitch registers
+	void cartWrite(uint16_t) { saveCart = true; } // 0x4***, flag to save cart on exit
+
 	// References set to refer back to Synth's communication pointers
 	ToSynth*& toSynth;
 	ToGui*& toGui;
@@ -116,6 +122,12 @@ struct DX7: public HD6303R {
 	// Load a firmware ROM
 	int loadROM(const char *romfile);
 
+	// Native routines for the hot spots of the v1.8 firmware, see dx7_hle.cc
+	void hleInstall();
+	template<uint8_t n, bool bra> int delay(int max);
+	int modSum(int max);
+	int pitchEG(int max);
+
 	// Display hardware
 	HD44780 lcd;
 
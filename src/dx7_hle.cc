@@ -0,0 +1,279 @@
+/**
+ *  VDX7 - Virtual DX7 synthesizer emulation
+ *  Copyright (C) 2023  chiaccona@gmail.com 
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+**/
+
+// High level emulation of hot routines of the v1.8 firmware, in place of
+// interpreting them (see HD6303R::Routine). Each one must leave exactly
+// the registers, memory and cycle count the interpreter would: run with
+// lockstep set to check.
+
+#include "dx7.h"
+#include "HD6303R_ops.h"
+
+static constexpr uint32_t ROM_V18 = 0x660900E0u; // HD6303R::romHash()
+
+static int cycles(uint8_t opcode) { return HD6303R::instInfo[opcode].cycles; }
+
+void DX7::hleInstall() {
+	if(romHash() != ROM_V18) return; // Interpret any other firmware
+	addRoutine(0xD8BF, static_cast<Routine>(&DX7::delay<1, false>));
+	addRoutine(0xD8CB, static_cast<Routine>(&DX7::delay<3, true>));
+	addRoutine(0xD8D1, static_cast<Routine>(&DX7::delay<7, true>));
+	addRoutine(0xD8D7, static_cast<Routine>(&DX7::delay<90, true>));
+	addRoutine(0xE616, static_cast<Routine>(&DX7::pitchEG));
+	addRoutine(0xE7C4, static_cast<Routine>(&DX7::modSum));
+}
+
+// Delay loops, e.g. for the LCD: PSHA PSHB LDAB #n, BRA to D8C3 unless
+// entered there, n times PSHX PULX DECB BNE, then PULB PULA RTS.
+// Only the last pass's stack writes are left in memory.
+template<uint8_t n, bool bra> int DX7::delay(int max) {
+	int c = cycles(0x36) + cycles(0x37) + cycles(0xC6) + (bra ? cycles(0x20) : 0)
+		+ n*(cycles(0x3C) + cycles(0x38) + cycles(0x5A) + cycles(0x26))
+		+ cycles(0x33) + cycles(0x32) + cycles(0x39);
+	if(c > max) return 0;
+	M[SP--] = A;
+	M[SP--] = B;
+	push(IX);
+	pull(IX);
+	B = 0;
+	D8(B);
+	B = M[++SP];
+	A = M[++SP];
+	pull(PC);
+	opcode = 0x39;
+	return c;
+}
+
+// E7C4 up to E7D7, with the subroutine at E80C: sums into B the four
+// modulation source amounts at 232E whose flag byte has bit 0 set,
+// stopping at FF on overflow
+int DX7::modSum(int max) {
+	if(max < 256) return 0; // Enough for the longest path
+	int c = cycles(0x86) + cycles(0x5F) + cycles(0xCE);
+	A = 4; // LDAA #4
+	L8(A);
+	B = 0; // CLRB
+	flags(fN|fZ|fV|fC);
+	N = V = C = 0;
+	Z = 1;
+	IX = 0x232E; // LDX #232E
+	L16(IX);
+	for(;;) {
+		M[SP--] = A; // PSHA
+		push(0xE7CD); // BSR E80C
+		A = M[IX]; // LDAA 0,X
+		L8(A);
+		IX++; // INX
+		flags(fZ);
+		Z = !IX;
+		L8(A&1); // BITA #1
+		c += cycles(0x36) + cycles(0x8D) + cycles(0xA6) + cycles(0x08) + cycles(0x85) + cycles(0x27);
+		flags(fZ);
+		if(!Z) { // BEQ not taken
+			uint8_t m = M[IX];  // ADDB 0,X
+			R = B+m;
+			A8(B, m, R);
+			B = R;
+			c += cycles(0xEB) + cycles(0x24);
+			flags(fC);
+			if(C) { // BCC not taken
+				B = 0xFF; // LDAB #FF
+				L8(B);
+				c += cycles(0xC6);
+			}
+		}
+		pull(PC); // RTS
+		c += cycles(0x39) + cycles(0x25);
+		flags(fC);
+		if(C) { // BCS E7D6
+			A = M[++SP]; // PULA
+			c += cycles(0x32);
+			opcode = 0x32;
+			break;
+		}
+		IX++; // INX
+		flags(fZ);
+		Z = !IX;
+		A = M[++SP]; // PULA
+		A--; // DECA
+		D8(A);
+		c += cycles(0x08) + cycles(0x32) + cycles(0x4A) + cycles(0x26);
+		flags(fZ);
+		if(Z) { // BNE not taken, BRA E7D7
+			c += cycles(0x20);
+			opcode = 0x20;
+			break;
+		}
+	}
+	PC = 0xE7D7;
+	return c;
+}
+
+// E616 to its RTS: the pitch EG of each of the 16 voices, at step 2130
+// and level 2140, moves by the rate at 2160 toward the target at 2164
+// unless it is sustaining (3) or done (5), and on reaching the target goes
+// on to the next step, wrapping at 6. D1 and D3 hold the rate and target.
+int DX7::pitchEG(int max) {
+	int moving = 0;
+	for(int v = 0; v < 16; v++) moving += M[0x2130+v] != 3 && M[0x2130+v] != 5;
+	if(max < 32 + 16*64 + moving*128) return 0; // Enough for the longest paths
+	// LDX #2140 STX CD LDX #2130 STX CF LDAB #16 STAB CC
+	int c = 2*(cycles(0xCE) + cycles(0xDF)) + cycles(0xC6) + cycles(0xD7);
+	B = 16;
+	L8(B);
+	for(int v = 0; v < 16; v++) {
+		const uint16_t level = 0x2140 + 2*v, step = 0x2130 + v;
+		A = M[step]; // LDAA 0,X
+		L8(A);
+		R = A-3; // CMPA #3
+		S8(A, 3, R);
+		c += cycles(0xA6) + cycles(0x81) + cycles(0x26);
+		flags(fZ);
+		if(!Z) { // BNE E62D
+			R = A-5; // CMPA #5
+			S8(A, 5, R);
+			c += cycles(0x81) + cycles(0x26);
+			flags(fZ);
+		}
+		if(Z) c += cycles(0x7E); // JMP E684
+		else { // E634
+			IX = 0x2160; // LDX #2160
+			L16(IX);
+			R = A-3; // CMPA #3
+			S8(A, 3, R);
+			c += cycles(0xCE) + cycles(0x81) + cycles(0x25);
+			flags(fC);
+			if(!C) { // LDAA #3
+				A = 3;
+				L8(A);
+				c += cycles(0x86);
+			}
+			B = A; // TAB
+			L8(B);
+			IX += B; // ABX
+			B = M[IX]; // LDAB 0,X
+			L8(B);
+			A = 0; // CLRA
+			flags(fN|fZ|fV|fC);
+			N = V = C = 0;
+			Z = 1;
+			const uint16_t rate = D;
+			stom16(0xD1, rate); // STD D1
+			L16(D);
+			A = M[IX+4]; // LDAA 4,X
+			L8(A);
+			B = 0; // CLRB
+			flags(fN|fZ|fV|fC);
+			N = V = C = 0;
+			Z = 1;
+			lsrd(D); // LSRD
+			const uint16_t target = D;
+			stom16(0xD3, target); // STD D3
+			L16(D);
+			IX = getm16(level); // LDX CD, LDX 0,X
+			L16(IX);
+			R2 = IX-target; // CPX D3
+			S16(IX, target, R2);
+			c += cycles(0x16) + cycles(0x3A) + cycles(0xE6) + cycles(0x4F) + cycles(0xDD)
+				+ cycles(0xA6) + cycles(0x5F) + cycles(0x04) + cycles(0xDD)
+				+ cycles(0xDE) + cycles(0xEE) + cycles(0x9C) + cycles(0x27);
+			flags(fZ|fC);
+			bool reached = Z; // BEQ E66C
+			if(!reached) {
+				const bool rising = C; // BCS E662
+				IX = level; // LDX CD
+				L16(IX);
+				D = getm16(IX); // LDD 0,X
+				L16(D);
+				c += cycles(0x25) + cycles(0xDE) + cycles(0xEC);
+				if(rising) {
+					R2 = D+rate; // ADDD D1
+					A16(D, rate, R2);
+					D = R2;
+					R = A-M[0xD3]; // CMPA D3
+					S8(A, M[0xD3], R);
+					c += cycles(0xD3) + cycles(0x91) + cycles(0x25);
+					flags(fC);
+					reached = !C; // BCS E680 not taken
+				} else {
+					R2 = D-rate; // SUBD D1
+					S16(D, rate, R2);
+					D = R2;
+					c += cycles(0x93) + cycles(0x2B);
+					flags(fN);
+					reached = N; // BMI E66C
+					if(!reached) {
+						R = A-M[0xD3]; // CMPA D3
+						S8(A, M[0xD3], R);
+						c += cycles(0x91) + cycles(0x22);
+						flags(fC|fZ);
+						reached = C || Z; // BHI E680 not taken
+						if(reached) c += cycles(0x20); // BRA E66C
+					}
+				}
+			}
+			if(reached) { // E66C: level = target, next step
+				D = target; // LDD D3
+				L16(D);
+				IX = level; // LDX CD
+				L16(IX);
+				stom16(IX, D); // STD 0,X
+				L16(D);
+				IX = step; // LDX CF
+				L16(IX);
+				A = M[IX]; // LDAA 0,X
+				L8(A);
+				A++; // INCA
+				I8(A);
+				R = A-6; // CMPA #6
+				S8(A, 6, R);
+				c += cycles(0xDC) + cycles(0xDE) + cycles(0xED) + cycles(0xDE) + cycles(0xA6)
+					+ cycles(0x4C) + cycles(0x81) + cycles(0x26) + cycles(0xA7) + cycles(0x20);
+				flags(fZ);
+				if(Z) { // CLRA
+					A = 0;
+					flags(fN|fZ|fV|fC);
+					N = V = C = 0;
+					Z = 1;
+					c += cycles(0x4F);
+				}
+				M[IX] = A; // STAA 0,X, BRA E684
+				L8(A);
+			} else { // E680: level moves
+				IX = level; // LDX CD
+				L16(IX);
+				stom16(IX, D); // STD 0,X
+				L16(D);
+				c += cycles(0xDE) + cycles(0xED);
+			}
+		}
+		// E684: LDX CD INX INX STX CD LDX CF INX STX CF DEC CC BEQ E697
+		IX = step+1;
+		L16(IX);
+		M[0xCC] = 15-v;
+		D8(M[0xCC]);
+		c += 2*cycles(0xDE) + 3*cycles(0x08) + 2*cycles(0xDF) + cycles(0x7A) + cycles(0x27);
+		if(v < 15) c += cycles(0x7E); // JMP E624
+	}
+	stom16(0xCD, 0x2160);
+	stom16(0xCF, 0x2140);
+	pull(PC); // RTS
+	c += cycles(0x39);
+	opcode = 0x39;
+	return c;
+}
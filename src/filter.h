@@ -18,6 +18,7 @@
 
 #pragma once
 #include <cmath>
+#include <vector>
 
 // Single pole lowpass to filter MIDI volume
 struct LP1 {
@@ -29,63 +30,77 @@ struct LP1 {
 	float a0, b1, y1;
 };
 
-// First order lowpass section
-struct LP {
-	LP() { }
-	void reset() { x1 = y1 = 0.; }
-	float operate(float s) {
-		y1 = s + b1*x1 - a0*y1;
-		x1 = s;
-		return y1;
-	}
-	float a0=0.0, b1=0.0, y1=0.0, x1=0.0;
-};
-
-// Second Order Section filter
-struct SOS_Coeff { float b1, b2, a1, a2; };
-struct SOS {
-	SOS_Coeff coeff;
-	int h=0;
-	float x[2]={0}, y[2]={0}; // history 
+// DX7 5th order Sallen-Key topology decimation filter
+// Fixed SR at 16*49.096khz
+// A first order lowpass and two second order sections, run on 16 inputs
+// at a time, of which only the output at the last is kept. So rather than
+// stepping through the cascade per input, the state after the 16 and that
+// output are computed directly: each is a fixed linear combination of the
+// inputs and the state before, precomputed (in double) at construction.
+// That is a few independent multiply-adds, with no chain through the
+// cascade, and a vector lane per row. operate() isn't inlined, so that the
+// kernels for each instruction set (see Dispatch.h) share it: with
+// -ffast-math the compiler may sum the rows in a different order for each
+// vector width.
+struct Filter {
+	static constexpr int Decim = 16, Order = 5;
+	static constexpr int Cols = Decim+Order, Rows = 8; // The state, the output, padding
+	typedef float Column __attribute__((vector_size(Rows*sizeof(float))));
+	Column m[Cols] = {}; // By inputs then state
+	Column state = {};
 
-	SOS() = default;
-	SOS(const SOS_Coeff& x) : coeff(x) {}
+	// Lowpass (1 + b1/z) / (1 + a0/z)
+	static constexpr double lpB1 = 1.0000065695182569, lpA0 = -0.9471494282369527;
+	// Sections (1 + b1/z + b2/z^2) / (1 + a1/z + a2/z^2)
+	static constexpr double sos[2][4] = {
+		{ 1.9999934304817428, 0.9999934305249014, -1.9047157177069487, 0.9129212928486624 },
+		{ 2.0000000000000000, 1.0000000000000000, -1.9531729648773684, 0.9694025617460298 },
+	};
+	static constexpr double gain = 2.1994620400553497e-07;
 
-	// DF-I implementation
-	float operate(float s) {
-		float r = s;
-		r += coeff.b1 * x[h]; r -= coeff.a1 * y[h];
-		h ^= 1;
-		r += coeff.b2 * x[h]; r -= coeff.a2 * y[h];
-		y[h] = r; x[h] = s;
-		return r;
+	// One input through the cascade (transposed direct form II)
+	static double step(double *s, double x) {
+		double y = x + s[0];
+		s[0] = lpB1*x - lpA0*y;
+		x = y;
+		for(int i=0; i<2; i++) {
+			const double *c = sos[i];
+			double *si = s + 1 + 2*i;
+			y = x + si[0];
+			si[0] = c[0]*x - c[2]*y + si[1];
+			si[1] = c[1]*x - c[3]*y;
+			x = y;
+		}
+		return gain*x;
 	}
-};
 
-// DX7 5th order Sallen-Key topology decimation filter
-// Fixed SR at 16*49.096khz
-struct Filter {
-	LP lp;
-	SOS sos1;
-	SOS sos2;
-	float gain;
+	// Impulse response (in double), until it stays below tail of the peak
+	static std::vector<double> response(double tail) {
+		std::vector<double> h(4096);
+		double s[Order] = {0}, peak = 0;
+		for(size_t i=0; i<h.size(); i++) peak = std::max(peak, std::fabs(h[i] = step(s, i==0)));
+		size_t n = h.size();
+		while(n > 1 && std::fabs(h[n-1]) < tail*peak) n--;
+		h.resize(n);
+		return h;
+	}
 
 	Filter() {
-		lp.b1 = 1.0000065695182569;
-		lp.a0 = -0.9471494282369527;
-		sos1.coeff.b1 = 1.9999934304817428;
-		sos1.coeff.b2 = 0.9999934305249014;
-		sos1.coeff.a1 = -1.9047157177069487;
-		sos1.coeff.a2 = 0.9129212928486624;
-		sos2.coeff.b1 = 2.0000000000000000;
-		sos2.coeff.b2 = 1.0000000000000000;
-		sos2.coeff.a1 = -1.9531729648773684;
-		sos2.coeff.a2 = 0.9694025617460298;
-		gain = 2.1994620400553497e-07;
+		// Response to each input, and each state variable, alone
+		for(int j=0; j<Cols; j++) {
+			double s[Order] = {0}, y = 0;
+			if(j >= Decim) s[j-Decim] = 1;
+			for(int k=0; k<Decim; k++) y = step(s, k==j);
+			for(int i=0; i<Order; i++) m[j][i] = s[i];
+			m[j][Order] = y;
+		}
 	}
 
-	float operate(float s) {
-		return gain * sos2.operate( sos1.operate( lp.operate(s) ) );
+	__attribute__((noinline)) float operate(const float *in) {
+		Column r = m[0]*in[0], q = m[Decim]*state[0];
+		for(int j=1; j<Decim; j++) r += m[j]*in[j];
+		for(int j=1; j<Order; j++) q += m[Decim+j]*state[j];
+		state = r + q;
+		return state[Order];
 	}
 };
-
@@ -0,0 +1,110 @@
+/**
+ *  VDX7 - Virtual DX7 synthesizer emulation
+ *  Copyright (C) 2023  chiaccona@gmail.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+**/
+
+// S-K decimation filter check
+//
+// Usage: filtertest
+//
+// Runs noise, sines and steps through Filter (filter.h), and through the
+// float cascade it replaced (a first order lowpass and two second order
+// sections, stepped per input and decimated by 16), with inputs scaled as
+// EGS::filter() scales the OPS output. Reports the RMS deviation between
+// the two, relative to the cascade's RMS output, and fails if any is above
+// Bound.
+
+#include <cstdio>
+#include <cstdint>
+#include <cmath>
+#include <initializer_list>
+#include "filter.h"
+
+static constexpr double Bound = -95; // dB
+static constexpr double Rate = 16*49096.0; // Of the input
+static constexpr long Samples = 5*49096; // Outputs per signal
+
+// The previous implementation, as the reference
+struct Cascade {
+	struct LP {
+		float a0 = -0.9471494282369527, b1 = 1.0000065695182569, y1 = 0, x1 = 0;
+		float operate(float s) {
+			y1 = s + b1*x1 - a0*y1;
+			x1 = s;
+			return y1;
+		}
+	};
+	struct SOS { // DF-I
+		float b1, b2, a1, a2;
+		int h = 0;
+		float x[2] = {0}, y[2] = {0};
+		float operate(float s) {
+			float r = s;
+			r += b1*x[h]; r -= a1*y[h];
+			h ^= 1;
+			r += b2*x[h]; r -= a2*y[h];
+			y[h] = r; x[h] = s;
+			return r;
+		}
+	};
+	LP lp;
+	SOS sos1 = { 1.9999934304817428, 0.9999934305249014, -1.9047157177069487, 0.9129212928486624 };
+	SOS sos2 = { 2.0000000000000000, 1.0000000000000000, -1.9531729648773684, 0.9694025617460298 };
+	float gain = 2.1994620400553497e-07;
+	float operate(float s) { return gain*sos2.operate(sos1.operate(lp.operate(s))); }
+};
+
+// Deviation of Filter from Cascade (dB), on the input signal(n)
+template<typename Signal> static double deviation(Signal signal) {
+	Filter filter;
+	Cascade cascade;
+	double err = 0, ref = 0;
+	long n = 0;
+	for(long i=0; i<Samples; i++) {
+		float in[Filter::Decim], y = 0;
+		for(int k=0; k<Filter::Decim; k++, n++) {
+			// As EGS::filter(): 14 bit OPS samples, 16/2^15 gain
+			in[k] = 16.0f/float(1<<15)*float(int32_t(std::lrint(8191*signal(n))));
+			y = cascade.operate(in[k]);
+		}
+		double d = filter.operate(in) - y;
+		err += d*d;
+		ref += double(y)*y;
+	}
+	return 10*log10(err/ref);
+}
+
+static bool check(const char *name, double dB) {
+	bool ok = dB <= Bound;
+	printf("%-14s %7.1f dB%s\n", name, dB, ok ? "" : " FAIL");
+	return ok;
+}
+
+int main() {
+	bool ok = true;
+	uint32_t seed = 1;
+	ok &= check("noise", deviation([&](long) {
+		return (seed = seed*1664525 + 1013904223)/2147483648.0 - 1;
+	}));
+	for(double f : { 100.0, 1000.0, 5000.0, 15000.0, 23000.0 }) {
+		char name[32];
+		snprintf(name, sizeof(name), "sine %.0fhz", f);
+		ok &= check(name, deviation([&](long n) { return sin(2*M_PI*f*n/Rate); }));
+	}
+	ok &= check("steps", deviation([&](long n) { return (n/long(Rate/10))%2 ? 1.0 : -1.0; }));
+	printf("%s (bound %.0f dB)\n", ok ? "OK" : "FAILED", Bound);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,143 @@
+/**
+ *  VDX7 - Virtual DX7 synthesizer emulation
+ *  Copyright (C) 2023  chiaccona@gmail.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+**/
+
+// Lazy flags check
+//
+// Usage: lazyflagstest [every]
+//
+// Boots the firmware and plays a scripted MIDI session, one instruction per
+// step (no fusing, native routines or idle skipping), hashing PC, A, B, IX,
+// SP, CCR and the cycle count after every instruction. The hash is printed
+// every 65536 (or every) instructions. `make lazyflagstest` builds it with
+// the eager and the lazy (USE_LAZY_FLAGS) condition codes and compares the
+// two outputs, which must be identical; every=1 finds the first difference.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include "dx7.h"
+
+static const char *usage = "Usage: lazyflagstest [every]\n";
+
+static constexpr double NativeRate = 49096.354; // Samples/sec
+static constexpr int Block = 128;
+
+static long every = 1<<16;
+static uint64_t count = 0, hash = 14695981039346656037u; // FNV-1a
+
+static void fnv(uint64_t x, int bytes) {
+	for(int i=0; i<bytes; i++, x >>= 8) {
+		hash ^= x&0xFF;
+		hash *= 1099511628211u;
+	}
+}
+
+// The CCR, leaving any pending lazy flags pending, so that the check
+// doesn't evaluate them earlier than the CPU would
+static uint8_t peekCCR(DX7 &dx7) {
+#ifdef LAZY_FLAGS
+	bool h = dx7.H, n = dx7.N, z = dx7.Z, v = dx7.V, c = dx7.C;
+	uint8_t mask = dx7.lazyMask;
+	uint8_t ccr = dx7.getCCR();
+	dx7.H = h, dx7.N = n, dx7.Z = z, dx7.V = v, dx7.C = c;
+	dx7.lazyMask = mask;
+	return ccr;
+#else
+	return dx7.getCCR();
+#endif
+}
+
+static void record(DX7 &dx7) {
+	fnv(dx7.PC, 2);
+	fnv(dx7.A, 1);
+	fnv(dx7.B, 1);
+	fnv(dx7.IX, 2);
+	fnv(dx7.SP, 2);
+	fnv(peekCCR(dx7), 1);
+	fnv(dx7.cycle, 8);
+	if(++count % every == 0) printf("%lu %lu %04X %016lx\n", count, dx7.cycle, dx7.PC, hash);
+}
+
+// Run for about n output samples, as opsbench but with fuseLimit left at 0
+static void render(DX7 &dx7, App_ToGui &toGui, long n) {
+	static float buffer[2*Block];
+	long done = 0;
+	Message msg;
+	while(done < n) {
+		int count = 0;
+		while(count + dx7.egs.lagging() < Block) {
+			if(dx7.egs.logFull()) dx7.egs.render(buffer, count);
+			dx7.run();
+			record(dx7);
+			dx7.egs.clock(buffer, count, 4*dx7.inst->cycles);
+		}
+		dx7.egs.render(buffer, count);
+		done += count;
+		while(toGui.pop(msg)) { } // LCD and LEDs
+	}
+}
+
+static void midi(DX7 &dx7, uint8_t status, uint8_t data1, uint8_t data2=0) {
+	dx7.midiSerialRx.write(status);
+	dx7.midiSerialRx.write(data1);
+	if((status&0xF0) != 0xC0 && (status&0xF0) != 0xD0) dx7.midiSerialRx.write(data2);
+}
+
+int main(int argc, char **argv) {
+	if(argc > 1) every = atol(argv[1]);
+	if(argc > 2 || every <= 0) {
+		fprintf(stderr, "%s", usage);
+		return(1);
+	}
+
+	App_ToSynth appToSynth;
+	App_ToGui appToGui;
+	ToSynth *toSynth = &appToSynth;
+	ToGui *toGui = &appToGui;
+	// Never deleted, so that the RAM isn't saved back on exit
+	DX7 *dx7 = new DX7(toSynth, toGui, "example.ram");
+	dx7->skipIdle = false; // Recording an idle loop reads the CCR
+	dx7->start();
+	render(*dx7, appToGui, NativeRate); // Boot
+
+	// On each of a few voices a chord, with pitch bend, modulation wheel,
+	// aftertouch and sustain, then its release
+	static const uint8_t voices[] = { 0, 7, 14, 21, 28 };
+	static const uint8_t chord[] = { 36, 48, 55, 60, 64, 67, 72, 96 };
+	for(uint8_t v : voices) {
+		midi(*dx7, 0xC0, v);
+		render(*dx7, appToGui, NativeRate/10);
+		for(uint8_t n : chord) midi(*dx7, 0x90, n, 20+n);
+		render(*dx7, appToGui, NativeRate/4);
+		for(int b=0; b<128; b+=16) {
+			midi(*dx7, 0xE0, 0, b);
+			midi(*dx7, 0xB0, 1, 127-b);
+			midi(*dx7, 0xD0, b);
+			render(*dx7, appToGui, NativeRate/20);
+		}
+		midi(*dx7, 0xE0, 0, 64);
+		midi(*dx7, 0xB0, 64, 127);
+		for(uint8_t n : chord) midi(*dx7, 0x80, n, 0);
+		render(*dx7, appToGui, NativeRate/4);
+		midi(*dx7, 0xB0, 64, 0);
+		render(*dx7, appToGui, NativeRate/2);
+	}
+
+	printf("%lu instructions, %lu cycles, %016lx\n", count, dx7->cycle, hash);
+	return(0);
+}
@@ -32,6 +32,7 @@ struct DX7Plugin {
 	LV2_Atom_Sequence* midi_out = 0;
 	LV2_Atom_Sequence* control_out = 0;
 	float* out = 0;
+	const float* quality = 0; // Resampler tier, see DX7Synth::setQuality()
 	double rate = 1;
 
 	// Features
@@ -81,6 +82,7 @@ struct DX7Plugin {
 			case 1: midi_out = (LV2_Atom_Sequence*)data; break;
 			case 2: control_out = (LV2_Atom_Sequence*)data; break;
 			case 3: out = (float*)data; break;
+			case 4: quality = (const float*)data; break;
 			default: break;
 		}
 	}
@@ -90,6 +92,8 @@ struct DX7Plugin {
 	void run(uint32_t nframes) {
 		if(!running) return;
 
+		if(quality && int(*quality) != dx7.quality) dx7.setQuality(int(*quality));
+
 		int midi_events = 0;
 
 		struct MIDINoteEvent {
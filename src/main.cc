@@ -85,7 +85,7 @@ int getConfigFile(std::string &fn) {
 int main(int argc, char* argv[]) {
 	int err;
 
-	const char* opts = "c:n:b:B:s:t:V:i:o:p:r:aqhvmk";
+	const char* opts = "c:n:b:B:s:t:V:i:o:p:r:T:R:aqhvmkLIPF";
 	const struct option long_opts[] = {
 		{"cart",		required_argument,	0,	'c'},
 		{"new",			required_argument,	0,	'n'},
@@ -98,10 +98,16 @@ int main(int argc, char* argv[]) {
 		{"midi-out",	required_argument,	0,	'o'},
 		{"port",		required_argument,	0,	'p'},
 		{"rom",			required_argument,	0,	'r'},
+		{"trace",		required_argument,	0,	'T'},
+		{"resampler",	required_argument,	0,	'R'},
 		{"noauto",		no_argument,		0,	'a'},
 		{"quiet",		no_argument,		0,	'q'},
 		{"serial",		no_argument,		0,	'm'},
 		{"keyboard",	no_argument,		0,	'k'},
+		{"lockstep",	no_argument,		0,	'L'},
+		{"interleave",	no_argument,		0,	'I'},
+		{"pipeline",	no_argument,		0,	'P'},
+		{"fused",		no_argument,		0,	'F'},
 		{"help",		no_argument,		0,	'h'},
 		{"version",		no_argument,		0,	'v'},
 		{0, 0, 0, 0},
@@ -122,7 +128,13 @@ int main(int argc, char* argv[]) {
 	int tuning = 0; // tuning value to set 
 	bool serial = false; // send midi directly to synth
 	bool showKeyboard = true; // show keybaord and controls on GUI
+	bool lockstep = false; // check native firmware routines against the interpreter
+	bool interleave = false; // clock the EGS and OPS after each CPU step
+	bool pipeline = false; // render the EGS and OPS on a second thread
+	bool fused = false; // filter and resample in one stage
+	int quality = -1; // resampler tier, or libsamplerate
 	char *velArg = 0; // velocity map
+	const char *tracefile = 0; // CPU instruction trace
 
 	int c;
 	while((c = getopt_long(argc, argv, opts, long_opts, 0)) != -1) {
@@ -156,6 +168,11 @@ int main(int argc, char* argv[]) {
 		case 'o': midi_out = optarg; break;
 		case 'p': port = optarg; break;
 		case 'r': romfile = optarg; break;
+		case 'T': tracefile = optarg; break;
+		case 'R':
+			quality = strcmp(optarg, "src") ? Resampler::tier(optarg) : DX7Synth::Libsamplerate;
+			if(quality<0) fprintf(stderr, "-R arg must be fast, medium, best or src\n");
+			break;
 
 		case 'v':
 			fprintf(stderr, "Version: %s " XSTR(VERSION) "\n", argv[0]);
@@ -164,6 +181,10 @@ int main(int argc, char* argv[]) {
 		case 'a': noauto = true; break;
 		case 'm': serial = true; break;
 		case 'k': showKeyboard = false; break;
+		case 'L': lockstep = true; break;
+		case 'I': interleave = true; break;
+		case 'P': pipeline = true; break;
+		case 'F': fused = true; break;
 		case 'q': quiet = true; break;
 		case 'h':
 		default:
@@ -175,9 +196,15 @@ int main(int argc, char* argv[]) {
 				"	-a don't autoconnect Jack midi\n"
 				"	-m send MIDI directly to DX7 serial interface\n"
 				"	-k don't show keyboard on GUI\n"
+				"	-L check native firmware routines against the interpreter (debug)\n"
+				"	-I don't run the CPU ahead of the EGS and OPS (debug)\n"
+				"	-P render the EGS and OPS on a second core (one more buffer of latency)\n"
+				"	-F filter and resample the 16 voices in one stage (no S-K decimation)\n"
+				"	-R fast|medium|best|src (resampler quality, default medium, src=libsamplerate)\n"
 				"	-c filename (sysex cartridge file)\n"
 				"	-n filename (create new sysex cartridge file)\n"
 				"	-r filename (load a firmware ROM)\n"
+				"	-T filename (record a CPU instruction trace, USE_TRACE builds)\n"
 				"	-b [0-7] (bank number: load factory voice cartridge into internal memory)\n"
 				"	-B [0-7] (bank number: load factory voice cartridge into cartridge memory)\n"
 				"	-s filename (save/restore RAM memory file, default ~/.config/vdx7/vdx7.ram)\n"
@@ -213,6 +240,19 @@ int main(int argc, char* argv[]) {
 	synth.toGui = &toGui;
 	synth.toSynth = &toSynth;
 	if(romfile) synth.dx7.loadROM(romfile);
+	synth.dx7.lockstep = lockstep;
+	if(interleave) synth.dx7.egs.runAhead(false);
+	else if(pipeline) synth.pipeline(true);
+	if(fused) synth.fuse(true);
+	if(quality>=0) synth.setQuality(quality);
+	if(tracefile) {
+#ifdef TRACE
+		err = synth.dx7.traceStart(tracefile);
+		if(err) fprintf(stderr, "Can't trace to %s (%d)\n", tracefile, err);
+#else
+		fprintf(stderr, "Tracing needs a USE_TRACE=1 build\n");
+#endif
+	}
 	synth.start();
 
 	// Load cartridge
@@ -0,0 +1,145 @@
+/**
+ *  VDX7 - Virtual DX7 synthesizer emulation
+ *  Copyright (C) 2023  chiaccona@gmail.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+**/
+
+// DSP benchmark
+//
+// Usage: opsbench [-i] [ramfile]
+//
+// Runs the DX7 emulation the way the audio callback does (the CPU run ahead
+// of the EGS and OPS, or with -i interleaved with them, and without the
+// resampler), playing chords on a few of the
+// voices in RAM, and reports the time per native output sample. Where
+// perf events are allowed it also reports the L1 data and last level cache
+// read miss rates, e.g. to compare the OPS table layouts (USE_EXPTAB), or
+// the instruction sets (VDX7_ISA, see Dispatch.h).
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "dx7.h"
+
+static const char *usage = "Usage: opsbench [-i] [ramfile]\n";
+
+static constexpr double NativeRate = 49096.354; // Samples/sec
+static constexpr int Block = 128;
+
+// Cache read event counter for this thread, -1 if not allowed
+static int counter(uint64_t cache, uint64_t result) {
+	perf_event_attr pe;
+	memset(&pe, 0, sizeof(pe));
+	pe.type = PERF_TYPE_HW_CACHE;
+	pe.size = sizeof(pe);
+	pe.config = cache | PERF_COUNT_HW_CACHE_OP_READ<<8 | result<<16;
+	pe.disabled = 1;
+	pe.exclude_kernel = 1;
+	pe.exclude_hv = 1;
+	return syscall(SYS_perf_event_open, &pe, 0, -1, -1, 0);
+}
+
+static uint64_t value(int fd) {
+	uint64_t v = 0;
+	if(fd < 0 || read(fd, &v, sizeof(v)) != sizeof(v)) return 0;
+	return v;
+}
+
+// Run for about n output samples, as DX7Synth::fillBuffer()
+static long render(DX7 &dx7, App_ToGui &toGui, long n) {
+	static float buffer[2*Block];
+	long done = 0;
+	Message msg;
+	while(done < n) {
+		int count = 0;
+		while(count + dx7.egs.lagging() < Block) {
+			if(dx7.egs.logFull()) dx7.egs.render(buffer, count);
+			dx7.fuseLimit = 24*(2*Block-2-count-dx7.egs.lagging());
+			dx7.run();
+			dx7.egs.clock(buffer, count, 4*dx7.inst->cycles);
+		}
+		dx7.egs.render(buffer, count);
+		done += count;
+		while(toGui.pop(msg)) { } // LCD and LEDs
+	}
+	return done;
+}
+
+static void midi(DX7 &dx7, uint8_t status, uint8_t data1, uint8_t data2=0) {
+	dx7.midiSerialRx.write(status);
+	dx7.midiSerialRx.write(data1);
+	if((status&0xF0) != 0xC0) dx7.midiSerialRx.write(data2);
+}
+
+int main(int argc, char **argv) {
+	bool interleave = argc > 1 && !strcmp(argv[1], "-i");
+	if(interleave) argv++, argc--;
+	if(argc > 2) {
+		fprintf(stderr, "%s", usage);
+		return(1);
+	}
+
+	App_ToSynth appToSynth;
+	App_ToGui appToGui;
+	ToSynth *toSynth = &appToSynth;
+	ToGui *toGui = &appToGui;
+	// Never deleted, so that the RAM isn't saved back on exit
+	DX7 *dx7 = new DX7(toSynth, toGui, argc > 1 ? argv[1] : "example.ram");
+	dx7->egs.runAhead(!interleave);
+	dx7->start();
+	render(*dx7, appToGui, NativeRate); // Boot
+
+	int fd[4] = {
+		counter(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_ACCESS),
+		counter(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_MISS),
+		counter(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_RESULT_ACCESS),
+		counter(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_RESULT_MISS),
+	};
+	for(int i=0; i<4; i++) if(fd[i] >= 0) ioctl(fd[i], PERF_EVENT_IOC_ENABLE, 0);
+	auto t0 = std::chrono::steady_clock::now();
+
+	// A sustained chord, then its release, on each of a few voices
+	static const uint8_t voices[] = { 0, 5, 10, 15, 20, 25, 30 };
+	static const uint8_t chord[] = { 48, 55, 60, 64, 67, 72 };
+	long samples = 0;
+	for(uint8_t v : voices) {
+		midi(*dx7, 0xC0, v);
+		samples += render(*dx7, appToGui, NativeRate/10);
+		for(uint8_t n : chord) midi(*dx7, 0x90, n, 100);
+		samples += render(*dx7, appToGui, NativeRate);
+		for(uint8_t n : chord) midi(*dx7, 0x80, n, 0);
+		samples += render(*dx7, appToGui, NativeRate/2);
+	}
+
+	auto t1 = std::chrono::steady_clock::now();
+	for(int i=0; i<4; i++) if(fd[i] >= 0) ioctl(fd[i], PERF_EVENT_IOC_DISABLE, 0);
+
+	double ns = std::chrono::duration<double, std::nano>(t1-t0).count() / samples;
+	printf("EXPTAB=%d %s%s: %ld samples, %.1f ns/sample (%.1fx realtime)\n",
+		EXPTAB, isaName(cpuIsa()), interleave ? " interleaved" : "", samples, ns, 1e9/NativeRate/ns);
+	const char *name[2] = { "L1D", "LLC" };
+	for(int c=0; c<2; c++) {
+		uint64_t access = value(fd[2*c]), miss = value(fd[2*c+1]);
+		if(access) printf("%s read misses: %.3f%% (%lu of %lu, %.2f/sample)\n",
+			name[c], 100.0*miss/access, miss, access, double(miss)/samples);
+		else printf("%s read misses: not available\n", name[c]);
+	}
+	return(0);
+}
@@ -0,0 +1,266 @@
+/**
+ *  VDX7 - Virtual DX7 synthesizer emulation
+ *  Copyright (C) 2023  chiaccona@gmail.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+**/
+
+// Build-time static recompiler for the DX7 firmware
+//
+// Usage: rom2cc firmware.bin firmware_rec.cc
+//
+// Translates the 16K ROM into HD6303R::stepNative(), a C++ function with
+// one label per instruction, each running the instruction body from
+// HD6303R_inst.h with its operand as a constant. Code is found by
+// following all static control flow from the interrupt vectors; anything
+// else (e.g. jump tables through IX) is left to the interpreter.
+//
+// A step starts at PC and keeps running instructions for as long as the
+// emulation could not tell the difference from single steps, and returns
+// their total cycle count (the same rules as the fused pairs of the
+// translation cache, see HD6303R::stepFused):
+// - the host's fuseLimit bounds the cycles run before the last
+//   instruction, and the step must end before the CPU's next event (see
+//   HD6303R::schedule) and within 255 cycles;
+// - nothing may change the I mask;
+// - only the first instruction may access the on-chip registers (the timer
+//   and SCI bookkeeping is done once, after the step);
+// - only the last may write anything other than plain RAM (the host acts
+//   on the last write, and the EGS is clocked after the step);
+// - a backward BRA ends the step if idle loops are skipped, so that the
+//   next one starts at the loop head (see HD6303R::idleLoop).
+// Indexed accesses are checked as they run.
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+static const char *usage = "Usage: rom2cc firmware.bin firmware_rec.cc\n";
+
+// Instruction set metadata
+struct Instruction {
+	bool legal=false;
+	const char *group="", *op="", *mode=""; // Nmemonics and address mode
+	bool r=0, w=0; // read or write
+	int bytes=0, cycles=0; // instr length and time
+};
+static Instruction instructions[256];
+
+static uint8_t memory[0x10000];
+static bool code[0x10000]; // Reachable instruction starts
+constexpr int ROM = 0xC000;
+
+static bool is(const char *s, const char *t) { return !strcmp(s, t); }
+
+static uint16_t operand(int a) {
+	const Instruction &i = instructions[memory[a]];
+	uint16_t x = 0;
+	for(int b=1; b<i.bytes; b++) x = x<<8 | memory[a+b];
+	return x;
+}
+
+// Statically known successors of an instruction: the next instruction
+// (or -1 if it never falls through) and a branch/jump/call target (or -1)
+static void successors(int a, int &next, int &target) {
+	const Instruction &i = instructions[memory[a]];
+	next = a + i.bytes;
+	target = -1;
+	if(is(i.group, "bra ") || is(i.group, "bsr ")) {
+		target = uint16_t(next + int8_t(memory[a+1]));
+		if(is(i.op, "bra ")) next = -1;
+		if(is(i.op, "brn ")) target = -1;
+	}
+	else if(is(i.group, "jmp ") || is(i.group, "jsr ")) {
+		if(is(i.mode, "ex")) target = operand(a);
+		if(is(i.group, "jmp ")) next = -1;
+	}
+	else if(is(i.group, "rts ") || is(i.group, "wait")) next = -1;
+	if(next > 0xFFFF) next = -1;
+}
+
+// Follow static control flow from a, marking the instructions
+static void trace(int a) {
+	static int work[0x10000];
+	int n = 0;
+	work[n++] = a;
+	while(n) {
+		a = work[--n];
+		while(a >= ROM && a <= 0xFFFF && !code[a]) {
+			const Instruction &i = instructions[memory[a]];
+			if(!i.legal || a + i.bytes > 0x10000) break;
+			code[a] = true;
+			int next, target;
+			successors(a, next, target);
+			if(target >= ROM) work[n++] = target;
+			a = next;
+		}
+	}
+}
+
+static bool isJump(const Instruction &i) { return is(i.group, "jmp ") || is(i.group, "jsr "); }
+
+// Memory operand of an instruction: -2 if none, -1 if indexed,
+// or the address
+static int dataAddress(int a) {
+	const Instruction &i = instructions[memory[a]];
+	if(isJump(i) && !is(i.mode, "in")) return -2; // Into ROM
+	if(is(i.mode, "di")) return i.bytes==3 ? operand(a)&0xFF : operand(a);
+	if(is(i.mode, "ex")) return operand(a);
+	if(is(i.mode, "in")) return -1;
+	return -2;
+}
+
+// Host and CPU act on nothing in plain RAM until the end of the step
+static bool plain(int a) {
+	return a >= 0x20 && (a&0xFFF0)!=0x2800 && (a&0xFF00)!=0x3000 && (a&0xF000)!=0x4000 && a < ROM;
+}
+
+// Condition for an access to address expression x to be safe mid-step,
+// "true", "false", or a C++ expression
+static void access(char *s, const Instruction &i, int addr, const char *x) {
+	bool w = i.w && !isJump(i); // jsr writes only the stack
+	if(addr == -2) strcpy(s, "true");
+	else if(addr >= 0) strcpy(s, (w ? plain(addr) && plain(addr+1) : addr >= 0x20) ? "true" : "false");
+	else if(w) sprintf(s, "plain(%s) && plain(%s+1)", x, x);
+	else sprintf(s, "%s >= 0x20", x);
+}
+
+static bool changesI(const Instruction &i) {
+	return is(i.op, "cli ") || is(i.op, "sei ") || is(i.op, "tap ") || is(i.op, "rti ")
+		|| is(i.group, "swi ") || is(i.group, "wait");
+}
+
+static void label(FILE *fp, int a) {
+	if(a >= 0 && code[a]) fprintf(fp, "goto L_%04X;", a);
+	else fprintf(fp, "goto out;");
+}
+
+static void translate(FILE *fp, int a) {
+	const Instruction &i = instructions[memory[a]];
+	int addr = dataAddress(a);
+	char ok[64];
+
+	fprintf(fp, "\tcase 0x%04X: L_%04X: // %.*s", a, a, int(strcspn(i.op, " ")), i.op);
+	if(i.bytes>1) fprintf(fp, " %s $%0*X", i.mode, 2*(i.bytes-1), operand(a));
+	fprintf(fp, "\n");
+
+	// Admission, if not the first instruction of the step
+	char idx[32];
+	sprintf(idx, "uint16_t(IX+0x%02X)", operand(a)&0xFF);
+	access(ok, i, addr, idx);
+	if(changesI(i) || is(ok, "false")) fprintf(fp, "\t\tif(T) goto out;\n");
+	else if(is(ok, "true")) fprintf(fp, "\t\tADMIT(%d, true);\n", i.cycles);
+	else fprintf(fp, "\t\tADMIT(%d, %s);\n", i.cycles, ok);
+	// Sync the registers if they may be accessed (only ever by the first)
+	if(addr >= 0 && addr < 0x20) fprintf(fp, "\t\tsyncRegs();\n");
+	else if(addr == -1) fprintf(fp, "\t\tif(!T) syncRegs();\n");
+
+	// Run it
+	fprintf(fp, "\t\tPC = 0x%04X; exec<0x%02X>(0x%04X); T += %d; last = 0x%02X;\n",
+		a + i.bytes, memory[a], operand(a), i.cycles, memory[a]);
+
+	// Chain to the next instruction, if this one allows it
+	access(ok, i, addr, "ADDR");
+	if(changesI(i) || is(ok, "false")) { fprintf(fp, "\t\tgoto out;\n"); return; }
+	if(!is(ok, "true")) fprintf(fp, "\t\tif(!(%s)) goto out;\n", ok);
+
+	int next, target;
+	successors(a, next, target);
+	if(is(i.op, "bra ") && target <= a) { // A loop head, see HD6303R::idleLoop
+		fprintf(fp, "\t\tif(skipIdle) goto out;\n");
+	}
+	if(is(i.group, "rts ") || (isJump(i) && !is(i.mode, "ex"))) {
+		fprintf(fp, "\t\tgoto dispatch;\n");
+		return;
+	}
+	if(target >= 0 && next >= 0 && !is(i.group, "bsr ") && !is(i.group, "jsr ")) { // Conditional
+		fprintf(fp, "\t\tif(PC == 0x%04X) ", target);
+		label(fp, target);
+		fprintf(fp, "\n");
+		target = -1;
+	}
+	if(target >= 0) next = target;
+	fprintf(fp, "\t\t");
+	label(fp, next);
+	fprintf(fp, "\n");
+}
+
+int main(int argc, char **argv) {
+	if(argc != 3) {
+		fprintf(stderr, "%s", usage);
+		return(1);
+	}
+
+#define OPCODE(op, grp, inst, am, r, w, bytes, cycles, ...) \
+	instructions[op] = Instruction{true, grp, inst, am, r, w, bytes, cycles};
+#include "HD6303R_inst.h"
+#undef OPCODE
+
+	FILE *fp = fopen(argv[1], "r");
+	if(!fp) {
+		fprintf(stderr, "Can't open dx7 firmware (%s)\n", argv[1]);
+		return(-1);
+	}
+	size_t count = fread(memory+ROM, 1, 0x10000-ROM, fp);
+	fclose(fp);
+	if(count != 0x10000-ROM) {
+		fprintf(stderr, "Not a dx7 firmware (size %ld != 16384)\n", count);
+		return(-2);
+	}
+
+	// FNV-1a, checked against the ROM at run time (HD6303R::romHash)
+	uint32_t hash = 2166136261u;
+	for(int a=ROM; a<0x10000; a++) hash = (hash ^ memory[a]) * 16777619u;
+
+	// Everything reachable from the vectors
+	for(int v=0xFFEA; v<0x10000; v+=2) trace(memory[v]<<8 | memory[v+1]);
+
+	fp = fopen(argv[2], "w");
+	if(!fp) {
+		fprintf(stderr, "Can't create %s\n", argv[2]);
+		return(-3);
+	}
+	fprintf(fp, "// Generated by rom2cc from %s - do not edit\n\n", argv[1]);
+	fprintf(fp, "#include <algorithm>\n#include \"HD6303R_ops.h\"\n\n");
+	fprintf(fp, "#pragma GCC diagnostic ignored \"-Wunused-label\"\n\n");
+	fprintf(fp, "bool HD6303R::nativeROM() { return romHash() == 0x%08Xu; }\n\n", hash);
+	fprintf(fp, "static inline bool plain(uint16_t a) {\n"
+		"\treturn a >= 0x20 && (a&0xFFF0)!=0x2800 && (a&0xFF00)!=0x3000 && (a&0xF000)!=0x4000 && a < HD6303R::ROM;\n}\n\n");
+	fprintf(fp, "#define ADMIT(c, ok) if(T) { if(T >= limit || T + c > room || !(ok)) goto out; OP = OP2 = ADDR = 0; }\n\n");
+	fprintf(fp, "bool HD6303R::stepNative() {\n"
+		"\tint T = 0; // Cycles run\n"
+		"\tuint8_t last = 0; // Last opcode\n"
+		"\tconst int limit = fuseLimit;\n"
+		"\tconst int room = std::min<int64_t>(int64_t(nextEvent - cycle) - 1, 255); // Before the next event\n\n"
+		"dispatch:\n"
+		"\tswitch(PC) {\n"
+		"\tdefault:\n"
+		"\t\tif(!T) return false;\n"
+		"\t\tgoto out;\n");
+	int n = 0;
+	for(int a=ROM; a<0x10000; a++) if(code[a]) { translate(fp, a); n++; }
+	fprintf(fp, "\t}\n\n"
+		"out:\n"
+		"\tfusedInfo = InstInfo{uint8_t(T), instInfo[last].r, instInfo[last].w, true};\n"
+		"\tinst = &fusedInfo;\n"
+		"\topcode = last;\n"
+		"\treturn true;\n"
+		"}\n");
+	if(fclose(fp)) {
+		fprintf(stderr, "Can't write %s\n", argv[2]);
+		return(-3);
+	}
+	fprintf(stderr, "rom2cc: %d instructions\n", n);
+	return(0);
+}
@@ -0,0 +1,216 @@
+/**
+ *  VDX7 - Virtual DX7 synthesizer emulation
+ *  Copyright (C) 2023  chiaccona@gmail.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+**/
+
+// Resampler benchmark
+//
+// Usage: srcbench [rate ...]
+//
+// Compares the built-in resampler's quality tiers (Resampler.h) with
+// libsamplerate, from the native rate to each host rate (by default 44.1k,
+// 48k, 88.2k and 96k). For each it reports the time per output sample, the
+// gain of a sine at 10k and 20khz (relative to 1khz), and the worst level of
+// everything else below 20khz, or 40% of the output rate (libsamplerate's
+// narrowest passband) if lower, over sines from 500hz to 24.5khz: aliases,
+// images and noise, relative to the sine. Above the output's Nyquist there
+// is no sine to keep, so it is all alias.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <complex>
+#include <chrono>
+#include <vector>
+#include <samplerate.h>
+#include "Resampler.h"
+
+static const char *usage = "Usage: srcbench [rate ...]\n";
+
+static constexpr double NativeRate = 49096.0; // As DX7Synth
+static constexpr int Block = 128, InBlock = 64; // Output, input per call
+static constexpr int N = 16384, Settle = 8192; // Analysed, skipped outputs
+
+// The input: a sine, or noise if f is 0
+struct Source {
+	double f;
+	long n = 0;
+	uint32_t seed = 1;
+	float buf[InBlock];
+	explicit Source(double f) : f(f) { }
+	void fill(float *out) {
+		for(int i=0; i<InBlock; i++, n++) {
+			if(f) out[i] = 0.5*sin(2*M_PI*f*double(n)/NativeRate);
+			else out[i] = (seed = seed*1664525 + 1013904223)/4294967296.0 - 0.5;
+		}
+	}
+};
+
+struct Converter {
+	virtual ~Converter() { }
+	virtual void read(float *out, int n) = 0;
+};
+
+struct Builtin : Converter {
+	Source &src;
+	Resampler r;
+	Builtin(Source &src, double rate, int tier) : src(src) {
+		r.design(NativeRate, rate, {1.0}, InBlock, Block);
+		r.quality(tier);
+	}
+	void read(float *out, int n) {
+		while(!r.ready(n)) {
+			src.fill(r.input());
+			r.commit(InBlock);
+		}
+		r.read(out, n);
+	}
+};
+
+struct Libsamplerate : Converter {
+	Source &src;
+	SRC_STATE *state;
+	double ratio;
+	Libsamplerate(Source &src, double rate, int type) : src(src), ratio(rate/NativeRate) {
+		int error;
+		if(!(state = src_callback_new(callback, type, 1, &error, this))) {
+			fprintf(stderr, "src_callback_new failed: %s\n", src_strerror(error));
+			exit(1);
+		}
+	}
+	~Libsamplerate() { src_delete(state); }
+	static long callback(void *data, float **audio) {
+		Libsamplerate *me = (Libsamplerate*)data;
+		me->src.fill(me->src.buf);
+		*audio = me->src.buf;
+		return InBlock;
+	}
+	void read(float *out, int n) { src_callback_read(state, ratio, n, out); }
+};
+
+static const char *names[] = { "fast", "medium", "best", "src fastest", "src medium", "src best" };
+static constexpr int Converters = 6;
+
+static Converter *make(int c, Source &src, double rate) {
+	if(c < Resampler::Tiers) return new Builtin(src, rate, c);
+	static const int type[] = { SRC_SINC_FASTEST, SRC_SINC_MEDIUM_QUALITY, SRC_SINC_BEST_QUALITY };
+	return new Libsamplerate(src, rate, type[c - Resampler::Tiers]);
+}
+
+static void fft(std::vector<std::complex<double>> &x) {
+	const int n = x.size();
+	for(int i=1, j=0; i<n; i++) {
+		int bit = n>>1;
+		for(; j&bit; bit>>=1) j ^= bit;
+		j ^= bit;
+		if(i < j) std::swap(x[i], x[j]);
+	}
+	for(int len=2; len<=n; len<<=1) {
+		std::complex<double> w = std::polar(1.0, -2*M_PI/len);
+		for(int i=0; i<n; i+=len) {
+			std::complex<double> wk = 1;
+			for(int k=0; k<len/2; k++, wk *= w) {
+				std::complex<double> a = x[i+k], b = x[i+k+len/2]*wk;
+				x[i+k] = a + b;
+				x[i+k+len/2] = a - b;
+			}
+		}
+	}
+}
+
+// Power spectrum of the output, Kaiser windowed (sidelobes below -180dB)
+static std::vector<double> spectrum(const float *y) {
+	static std::vector<double> w;
+	if(w.empty()) {
+		auto I0 = [](double x) {
+			double sum = 1, term = 1;
+			for(int i=1; term > 1e-12*sum; i++) sum += term *= (x/(2*i))*(x/(2*i));
+			return sum;
+		};
+		for(int i=0; i<N; i++) {
+			double r = 2.0*i/(N-1) - 1;
+			w.push_back(I0(20*sqrt(1 - r*r))/I0(20));
+		}
+	}
+	std::vector<std::complex<double>> x(N);
+	for(int i=0; i<N; i++) x[i] = w[i]*y[i];
+	fft(x);
+	std::vector<double> p(N/2);
+	for(int i=0; i<N/2; i++) p[i] = std::norm(x[i]);
+	return p;
+}
+
+// Sine's power, and the most of the rest in a band, from the spectrum
+static constexpr int Lobe = 12; // Bins either side of a sine
+static void measure(const std::vector<double> &p, double f, double rate, double band, double &sine, double &rest) {
+	int k = int(f/rate*N + 0.5), top = std::min(N/2, int(band/rate*N));
+	sine = rest = 0;
+	for(int i=1; i<N/2; i++) {
+		if(f < rate/2 && abs(i-k) <= Lobe) sine += p[i];
+		else if(i < top) rest += p[i];
+	}
+}
+
+static double dB(double power) { return 10*log10(std::max(power, 1e-30)); }
+
+int main(int argc, char **argv) {
+	std::vector<double> rates;
+	for(int i=1; i<argc; i++) {
+		double r = atof(argv[i]);
+		if(r < 8000) {
+			fprintf(stderr, "%s", usage);
+			return(1);
+		}
+		rates.push_back(r);
+	}
+	if(rates.empty()) rates = { 44100, 48000, 88200, 96000 };
+
+	std::vector<float> y(Settle + N);
+	for(double rate : rates) {
+		printf("%.0f hz        ns/out  10khz dB  20khz dB  alias/noise dB\n", rate);
+		double band = std::min(20000.0, 0.4*rate);
+		for(int c=0; c<Converters; c++) {
+			// Cost, on noise
+			Source noise(0);
+			Converter *conv = make(c, noise, rate);
+			const long outputs = 10*long(rate);
+			auto t0 = std::chrono::steady_clock::now();
+			for(long done=0; done<outputs; done+=Block) conv->read(y.data(), Block);
+			auto t1 = std::chrono::steady_clock::now();
+			delete conv;
+			double ns = std::chrono::duration<double, std::nano>(t1-t0).count()/outputs;
+
+			// Quality, on sines
+			double gain[3], ref = 0, worst = -1e9;
+			static const double at[3] = { 1000, 10000, 20000 };
+			for(int s=0; s<3+49; s++) {
+				double f = s < 3 ? at[s] : 500*(s-2);
+				if(f >= NativeRate/2) f = 24500;
+				Source sine(f);
+				conv = make(c, sine, rate);
+				for(int i=0; i<Settle+N; i+=Block) conv->read(y.data()+i, Block);
+				delete conv;
+				double ps, pr;
+				measure(spectrum(y.data()+Settle), f, rate, band, ps, pr);
+				if(s == 0) ref = ps;
+				if(s < 3) gain[s] = f < rate/2 ? dB(ps/ref) : NAN;
+				else worst = std::max(worst, dB(pr/ref));
+			}
+			printf("  %-12s %6.1f  %8.3f  %8.3f  %8.1f\n", names[c], ns, gain[1], gain[2], worst);
+		}
+	}
+	return(0);
+}
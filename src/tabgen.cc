@@ -0,0 +1,71 @@
+/**
+ *  VDX7 - Virtual DX7 synthesizer emulation
+ *  Copyright (C) 2023  chiaccona@gmail.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+**/
+
+// Build-time generator for the OPS ROM tables
+//
+// Usage: tabgen OPS_tables.h
+//
+// Writes the two tables of the OPS that need floating point math (the log
+// sine, and the mantissas of the exponential) as constexpr arrays, so they
+// are read only data rather than computed at startup. Everything else
+// derived from them is built by constexpr code in OPS.h.
+
+#include <cstdio>
+#include <cstdint>
+#include <cmath>
+
+static const char *usage = "Usage: tabgen OPS_tables.h\n";
+
+static const int LG_N = 10;
+static const int N = 1<<LG_N;
+
+static void write(FILE *fp, const char *name, const uint16_t *table) {
+	// +1 so a 32 bit gather of the last entry stays inside
+	fprintf(fp, "inline constexpr uint16_t %s[%d+1] = {", name, N);
+	for(int i=0; i<N; i++) fprintf(fp, "%s%5u,", i%16 ? " " : "\n\t", table[i]);
+	fprintf(fp, "\n\t0\n};\n\n");
+}
+
+int main(int argc, char **argv) {
+	if(argc != 2) {
+		fprintf(stderr, "%s", usage);
+		return(1);
+	}
+
+	// In: 10 bit phase (first quadrant). Out: -log2(sin) in 4.10
+	uint16_t logsin[N];
+	for(int i=0; i<N; i++) logsin[i] = int(.5002-N*log(sin((i+.5)/N*M_PI/2))/log(2));
+
+	// In: 10 bit fraction. Out: 2^x in 1.11
+	uint16_t exp2[N];
+	for(int i=0; i<N; i++) exp2[i] = uint16_t(.5+2*N*pow(2, double(i)/N));
+
+	FILE *fp = fopen(argv[1], "w");
+	if(!fp) {
+		fprintf(stderr, "Can't open %s\n", argv[1]);
+		return(-1);
+	}
+	fprintf(fp, "// Generated by tabgen from tabgen.cc, do not edit\n\n#pragma once\n#include <cstdint>\n\n");
+	write(fp, "logsinROM", logsin);
+	write(fp, "exp2ROM", exp2);
+	if(fclose(fp)) {
+		fprintf(stderr, "Can't write %s\n", argv[1]);
+		return(-2);
+	}
+	return(0);
+}
@@ -0,0 +1,87 @@
+/**
+ *  VDX7 - Virtual DX7 synthesizer emulation
+ *  Copyright (C) 2023  chiaccona@gmail.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+**/
+
+// Instruction trace decoder
+//
+// Usage: tracedump vdx7.trace
+//
+// Prints a trace recorded by a USE_TRACE=1 build (see Trace.h), one
+// instruction per line: cycle, address, disassembly, the memory it
+// accessed, and the registers after it.
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include "Trace.h"
+
+static const char *usage = "Usage: tracedump vdx7.trace\n";
+
+// Instruction set metadata
+struct Instruction {
+	bool legal=false;
+	const char *op="", *mode=""; // Nmemonic and address mode
+	int bytes=0;
+};
+static Instruction instructions[256];
+
+int main(int argc, char **argv) {
+	if(argc != 2) {
+		fprintf(stderr, "%s", usage);
+		return(1);
+	}
+
+#define OPCODE(op, grp, inst, am, r, w, bytes, cycles, ...) \
+	instructions[op] = Instruction{true, inst, am, bytes};
+#include "HD6303R_inst.h"
+#undef OPCODE
+
+	FILE *fp = fopen(argv[1], "r");
+	if(!fp) {
+		fprintf(stderr, "Can't open %s\n", argv[1]);
+		return(-1);
+	}
+	char magic[sizeof(TraceMagic)];
+	if(fread(magic, sizeof(magic), 1, fp) != 1 || memcmp(magic, TraceMagic, sizeof(magic))) {
+		fprintf(stderr, "Not a VDX7 trace (%s)\n", argv[1]);
+		fclose(fp);
+		return(-2);
+	}
+
+	TraceRecord r;
+	uint64_t n = 0, dropped = 0;
+	while(fread(&r, sizeof(r), 1, fp) == 1) {
+		if(r.dropped) {
+			printf("--- %u dropped\n", r.dropped);
+			dropped += r.dropped;
+		}
+		const Instruction &i = instructions[r.opcode];
+		char operand[8] = "";
+		if(i.bytes == 2) sprintf(operand, "$%02X", r.operand>>8);
+		else if(i.bytes == 3) sprintf(operand, "$%04X", r.operand);
+		char ccr[7] = "HINZVC";
+		for(int b=0; b<6; b++) if(!(r.ccr & 0x20>>b)) ccr[b] = '.';
+		printf("%12lu %04X  %-4.4s %2s %-5s  ", r.cycle, r.pc, i.legal ? i.op : "??? ", i.legal ? i.mode : "", operand);
+		if(r.addr) printf("[%04X] ", r.addr);
+		else printf("       ");
+		printf("A=%02X B=%02X X=%04X SP=%04X %s\n", r.a, r.b, r.ix, r.sp, ccr);
+		n++;
+	}
+	fclose(fp);
+	fprintf(stderr, "tracedump: %lu instructions, %lu dropped\n", n, dropped);
+	return(0);
+}